@@ -183,15 +183,22 @@ static int lfs_bd_prog(lfs_t *lfs,
             // already fits in pcache?
             lfs_size_t diff = lfs_min(size,
                     lfs->cfg->cache_size - (off-pcache->off));
-            memcpy(&pcache->buffer[off-pcache->off], data, diff);
+            if (data) {
+                memcpy(&pcache->buffer[off-pcache->off], data, diff);
+                data += diff;
+            } else {
+                // no buffer means program zeros
+                memset(&pcache->buffer[off-pcache->off], 0, diff);
+            }
 
-            data += diff;
             off += diff;
             size -= diff;
 
             pcache->size = lfs_max(pcache->size, off - pcache->off);
-            if (pcache->size == lfs->cfg->cache_size) {
-                // eagerly flush out pcache if we fill up
+            if (pcache->size == lfs->cfg->cache_size ||
+                    off == lfs->cfg->block_size) {
+                // eagerly flush out pcache if we fill up, appends in place
+                // may start mid-cache and reach the end of the block first
                 int err = lfs_bd_flush(lfs, pcache, rcache, validate);
                 if (err) {
                     return err;
@@ -214,6 +221,54 @@ static int lfs_bd_prog(lfs_t *lfs,
     return 0;
 }
 
+static int lfs_bd_copy(lfs_t *lfs,
+        lfs_cache_t *pcache, lfs_cache_t *rcache, bool validate,
+        lfs_block_t block, lfs_off_t off,
+        const lfs_cache_t *spcache, lfs_block_t sblock, lfs_off_t soff,
+        lfs_size_t size) {
+    LFS_ASSERT(block != LFS_BLOCK_NULL);
+    LFS_ASSERT(off + size <= lfs->cfg->block_size);
+
+    while (size > 0) {
+        if (!(block == pcache->block &&
+                off >= pcache->off &&
+                off < pcache->off + lfs->cfg->cache_size)) {
+            // pcache must have been flushed, same as lfs_bd_prog
+            LFS_ASSERT(pcache->block == LFS_BLOCK_NULL);
+            pcache->block = block;
+            pcache->off = lfs_aligndown(off, lfs->cfg->prog_size);
+            pcache->size = 0;
+        }
+
+        // read straight into the pcache, this saves needing a buffer
+        // of our own
+        lfs_size_t diff = lfs_min(size,
+                lfs->cfg->cache_size - (off-pcache->off));
+        int err = lfs_bd_read(lfs,
+                spcache, rcache, size,
+                sblock, soff, &pcache->buffer[off-pcache->off], diff);
+        if (err) {
+            return err;
+        }
+
+        off += diff;
+        soff += diff;
+        size -= diff;
+
+        pcache->size = lfs_max(pcache->size, off - pcache->off);
+        if (pcache->size == lfs->cfg->cache_size ||
+                off == lfs->cfg->block_size) {
+            // eagerly flush out pcache if we fill up
+            err = lfs_bd_flush(lfs, pcache, rcache, validate);
+            if (err) {
+                return err;
+            }
+        }
+    }
+
+    return 0;
+}
+
 static int lfs_bd_erase(lfs_t *lfs, lfs_block_t block) {
     LFS_ASSERT(block < lfs->cfg->block_count);
     int err = lfs->cfg->erase(lfs->cfg, block);
@@ -223,6 +278,43 @@ static int lfs_bd_erase(lfs_t *lfs, lfs_block_t block) {
 
 
 /// Small type-level utilities ///
+// min/max on file offsets, lfs_min/lfs_max would truncate these when
+// LFS_OFF64 is defined
+static inline lfs_foff_t lfs_offmin(lfs_foff_t a, lfs_foff_t b) {
+    return (a < b) ? a : b;
+}
+
+static inline lfs_foff_t lfs_offmax(lfs_foff_t a, lfs_foff_t b) {
+    return (a > b) ? a : b;
+}
+
+// bit operations on file offsets, built out of the 32-bit operations
+static inline uint32_t lfs_offnpw2(lfs_foff_t a) {
+#ifdef LFS_OFF64
+    if ((a-1) >> 32) {
+        return 32 + lfs_npw2((uint32_t)((a-1) >> 32) + 1);
+    }
+#endif
+    return lfs_npw2((uint32_t)a);
+}
+
+static inline uint32_t lfs_offctz(lfs_foff_t a) {
+#ifdef LFS_OFF64
+    if (!(uint32_t)a) {
+        return 32 + lfs_ctz((uint32_t)(a >> 32));
+    }
+#endif
+    return lfs_ctz((uint32_t)a);
+}
+
+static inline uint32_t lfs_offpopc(lfs_foff_t a) {
+#ifdef LFS_OFF64
+    return lfs_popc((uint32_t)a) + lfs_popc((uint32_t)(a >> 32));
+#else
+    return lfs_popc(a);
+#endif
+}
+
 // operations on block pairs
 static inline void lfs_pair_swap(lfs_block_t pair[2]) {
     lfs_block_t t = pair[0];
@@ -302,11 +394,6 @@ static inline lfs_size_t lfs_tag_dsize(lfs_tag_t tag) {
 }
 
 // operations on attributes in attribute lists
-struct lfs_mattr {
-    lfs_tag_t tag;
-    const void *buffer;
-};
-
 struct lfs_diskoff {
     lfs_block_t block;
     lfs_off_t off;
@@ -376,14 +463,117 @@ static inline void lfs_gstate_tole32(struct lfs_gstate *a) {
 }
 
 // other endianness operations
-static void lfs_ctz_fromle32(struct lfs_ctz *ctz) {
-    ctz->head = lfs_fromle32(ctz->head);
-    ctz->size = lfs_fromle32(ctz->size);
+//
+// ctz structs are stored as little-endian words, the hole, erased offset,
+// journal, and start are only stored if needed, other files keep the
+// original two-word ctz struct. Files past 32-bits use the wider ctz64
+// struct, which stores the size, hole, and start as two words each. Any
+// patches follow as pairs of words, index then block
+#define LFS_CTZ_WORDS (9 + 2*LFS_PATCH_MAX)
+
+// the patch table, which doesn't exist without LFS_PATCH_MAX, pcount is
+// always zero then
+#if LFS_PATCH_MAX > 0
+#define LFS_CTZ_PATCH(ctz) ((ctz)->patch)
+#else
+#define LFS_CTZ_PATCH(ctz) ((struct lfs_ctzpatch*)NULL)
+#endif
+
+static inline bool lfs_tag_isctz(lfs_tag_t tag) {
+    return lfs_tag_type3(tag) == LFS_TYPE_CTZSTRUCT ||
+            lfs_tag_type3(tag) == LFS_TYPE_CTZ64STRUCT;
+}
+
+static inline lfs_size_t lfs_ctz_patchcount(lfs_tag_t tag) {
+    // other structs may pass through here, these never have patches
+    lfs_size_t words = (lfs_tag_type3(tag) == LFS_TYPE_CTZ64STRUCT) ? 9 : 6;
+    lfs_size_t size = lfs_tag_isctz(tag) ? lfs_tag_size(tag) : 0;
+    return (size > 4*words) ? (size - 4*words) / 8 : 0;
+}
+
+static void lfs_ctz_patchfromdisk(lfs_tag_t tag, lfs_size_t words,
+        const uint32_t *buffer, struct lfs_ctz *ctz) {
+    // keep as many patches as we can, it's up to the caller to check if
+    // that is all of them
+    ctz->pcount = lfs_min(lfs_ctz_patchcount(tag), LFS_PATCH_MAX);
+    for (lfs_size_t i = 0; i < ctz->pcount; i++) {
+        LFS_CTZ_PATCH(ctz)[i].index = lfs_fromle32(buffer[words + 2*i+0]);
+        LFS_CTZ_PATCH(ctz)[i].block = lfs_fromle32(buffer[words + 2*i+1]);
+    }
+}
+
+static lfs_size_t lfs_ctz_patchtodisk(const struct lfs_ctz *ctz,
+        lfs_size_t words, uint32_t *buffer) {
+    for (lfs_size_t i = 0; i < ctz->pcount; i++) {
+        buffer[words + 2*i+0] = lfs_tole32(LFS_CTZ_PATCH(ctz)[i].index);
+        buffer[words + 2*i+1] = lfs_tole32(LFS_CTZ_PATCH(ctz)[i].block);
+    }
+
+    return 2*ctz->pcount*sizeof(uint32_t);
+}
+
+static int lfs_ctz_fromdisk(lfs_tag_t tag, const uint32_t *buffer,
+        struct lfs_ctz *ctz) {
+    ctz->head = lfs_fromle32(buffer[0]);
+    if (lfs_tag_type3(tag) == LFS_TYPE_CTZ64STRUCT) {
+#ifdef LFS_OFF64
+        ctz->size    = (lfs_foff_t)lfs_fromle32(buffer[1])
+                     | (lfs_foff_t)lfs_fromle32(buffer[2]) << 32;
+        ctz->hole    = (lfs_foff_t)lfs_fromle32(buffer[3])
+                     | (lfs_foff_t)lfs_fromle32(buffer[4]) << 32;
+        ctz->erased  = lfs_fromle32(buffer[5]);
+        ctz->journal = lfs_fromle32(buffer[6]);
+        ctz->start   = (lfs_foff_t)lfs_fromle32(buffer[7])
+                     | (lfs_foff_t)lfs_fromle32(buffer[8]) << 32;
+        lfs_ctz_patchfromdisk(tag, 9, buffer, ctz);
+        return 0;
+#else
+        // can't represent this file without LFS_OFF64
+        return LFS_ERR_FBIG;
+#endif
+    }
+
+    ctz->size    = lfs_fromle32(buffer[1]);
+    ctz->hole    = lfs_fromle32(buffer[2]);
+    ctz->erased  = lfs_fromle32(buffer[3]);
+    ctz->journal = lfs_fromle32(buffer[4]);
+    ctz->start   = lfs_fromle32(buffer[5]);
+    lfs_ctz_patchfromdisk(tag, 6, buffer, ctz);
+    return 0;
 }
 
-static void lfs_ctz_tole32(struct lfs_ctz *ctz) {
-    ctz->head = lfs_tole32(ctz->head);
-    ctz->size = lfs_tole32(ctz->size);
+static lfs_tag_t lfs_ctz_todisk(const struct lfs_ctz *ctz, uint16_t id,
+        uint32_t *buffer) {
+    buffer[0] = lfs_tole32(ctz->head);
+#ifdef LFS_OFF64
+    // start never passes the end of the file, so checking the end is enough
+    if (ctz->size + ctz->hole + ctz->journal > 0xffffffff) {
+        buffer[1] = lfs_tole32((uint32_t)(ctz->size >> 0));
+        buffer[2] = lfs_tole32((uint32_t)(ctz->size >> 32));
+        buffer[3] = lfs_tole32((uint32_t)(ctz->hole >> 0));
+        buffer[4] = lfs_tole32((uint32_t)(ctz->hole >> 32));
+        buffer[5] = lfs_tole32((uint32_t)ctz->erased);
+        buffer[6] = lfs_tole32(ctz->journal);
+        buffer[7] = lfs_tole32((uint32_t)(ctz->start >> 0));
+        buffer[8] = lfs_tole32((uint32_t)(ctz->start >> 32));
+        return LFS_MKTAG(LFS_TYPE_CTZ64STRUCT, id, 9*sizeof(uint32_t)
+                + lfs_ctz_patchtodisk(ctz, 9, buffer));
+    }
+#endif
+
+    buffer[1] = lfs_tole32((uint32_t)ctz->size);
+    buffer[2] = lfs_tole32((uint32_t)ctz->hole);
+    buffer[3] = lfs_tole32((uint32_t)ctz->erased);
+    buffer[4] = lfs_tole32(ctz->journal);
+    buffer[5] = lfs_tole32((uint32_t)ctz->start);
+    return LFS_MKTAG(LFS_TYPE_CTZSTRUCT, id,
+              ctz->pcount  ? 6*sizeof(uint32_t)
+                           + lfs_ctz_patchtodisk(ctz, 6, buffer)
+            : ctz->start   ? 6*sizeof(uint32_t)
+            : ctz->journal ? 5*sizeof(uint32_t)
+            : ctz->erased  ? 4*sizeof(uint32_t)
+            : ctz->hole    ? 3*sizeof(uint32_t)
+            :                2*sizeof(uint32_t));
 }
 
 static inline void lfs_superblock_fromle32(lfs_superblock_t *superblock) {
@@ -393,6 +583,7 @@ static inline void lfs_superblock_fromle32(lfs_superblock_t *superblock) {
     superblock->name_max    = lfs_fromle32(superblock->name_max);
     superblock->file_max    = lfs_fromle32(superblock->file_max);
     superblock->attr_max    = lfs_fromle32(superblock->attr_max);
+    superblock->patch_max   = lfs_fromle32(superblock->patch_max);
 }
 
 static inline void lfs_superblock_tole32(lfs_superblock_t *superblock) {
@@ -402,6 +593,29 @@ static inline void lfs_superblock_tole32(lfs_superblock_t *superblock) {
     superblock->name_max    = lfs_tole32(superblock->name_max);
     superblock->file_max    = lfs_tole32(superblock->file_max);
     superblock->attr_max    = lfs_tole32(superblock->attr_max);
+    superblock->patch_max   = lfs_tole32(superblock->patch_max);
+}
+
+// mount checkpoint, stored in the superblock pair
+struct lfs_checkpoint {
+    lfs_block_t root[2];
+    struct lfs_gstate gstate;
+    lfs_block_t lookahead;
+    uint32_t rev;
+};
+
+static inline void lfs_checkpoint_fromle32(struct lfs_checkpoint *ckpt) {
+    lfs_pair_fromle32(ckpt->root);
+    lfs_gstate_fromle32(&ckpt->gstate);
+    ckpt->lookahead = lfs_fromle32(ckpt->lookahead);
+    ckpt->rev = lfs_fromle32(ckpt->rev);
+}
+
+static inline void lfs_checkpoint_tole32(struct lfs_checkpoint *ckpt) {
+    lfs_pair_tole32(ckpt->root);
+    lfs_gstate_tole32(&ckpt->gstate);
+    ckpt->lookahead = lfs_tole32(ckpt->lookahead);
+    ckpt->rev = lfs_tole32(ckpt->rev);
 }
 
 
@@ -413,6 +627,9 @@ static int lfs_dir_compact(lfs_t *lfs,
         lfs_mdir_t *source, uint16_t begin, uint16_t end);
 static int lfs_file_outline(lfs_t *lfs, lfs_file_t *file);
 static int lfs_file_flush(lfs_t *lfs, lfs_file_t *file);
+static lfs_ssize_t lfs_file_rawwrite(lfs_t *lfs, lfs_file_t *file,
+        const void *buffer, lfs_size_t size);
+static int lfs_file_getcache(lfs_t *lfs, lfs_file_t *file);
 static void lfs_fs_preporphans(lfs_t *lfs, int8_t orphans);
 static void lfs_fs_prepmove(lfs_t *lfs,
         uint16_t id, const lfs_block_t pair[2]);
@@ -423,6 +640,7 @@ static lfs_stag_t lfs_fs_parent(lfs_t *lfs, const lfs_block_t dir[2],
 static int lfs_fs_relocate(lfs_t *lfs,
         const lfs_block_t oldpair[2], lfs_block_t newpair[2]);
 static int lfs_fs_forceconsistency(lfs_t *lfs);
+static int lfs_fs_prepwrite(lfs_t *lfs);
 static int lfs_deinit(lfs_t *lfs);
 #ifdef LFS_MIGRATE
 static int lfs1_traverse(lfs_t *lfs,
@@ -561,67 +779,6 @@ static lfs_stag_t lfs_dir_get(lfs_t *lfs, const lfs_mdir_t *dir,
             0, buffer, lfs_tag_size(gtag));
 }
 
-static int lfs_dir_getread(lfs_t *lfs, const lfs_mdir_t *dir,
-        const lfs_cache_t *pcache, lfs_cache_t *rcache, lfs_size_t hint,
-        lfs_tag_t gmask, lfs_tag_t gtag,
-        lfs_off_t off, void *buffer, lfs_size_t size) {
-    uint8_t *data = buffer;
-    if (off+size > lfs->cfg->block_size) {
-        return LFS_ERR_CORRUPT;
-    }
-
-    while (size > 0) {
-        lfs_size_t diff = size;
-
-        if (pcache && pcache->block == LFS_BLOCK_INLINE &&
-                off < pcache->off + pcache->size) {
-            if (off >= pcache->off) {
-                // is already in pcache?
-                diff = lfs_min(diff, pcache->size - (off-pcache->off));
-                memcpy(data, &pcache->buffer[off-pcache->off], diff);
-
-                data += diff;
-                off += diff;
-                size -= diff;
-                continue;
-            }
-
-            // pcache takes priority
-            diff = lfs_min(diff, pcache->off-off);
-        }
-
-        if (rcache->block == LFS_BLOCK_INLINE &&
-                off < rcache->off + rcache->size) {
-            if (off >= rcache->off) {
-                // is already in rcache?
-                diff = lfs_min(diff, rcache->size - (off-rcache->off));
-                memcpy(data, &rcache->buffer[off-rcache->off], diff);
-
-                data += diff;
-                off += diff;
-                size -= diff;
-                continue;
-            }
-
-            // rcache takes priority
-            diff = lfs_min(diff, rcache->off-off);
-        }
-
-        // load to cache, first condition can no longer fail
-        rcache->block = LFS_BLOCK_INLINE;
-        rcache->off = lfs_aligndown(off, lfs->cfg->read_size);
-        rcache->size = lfs_min(lfs_alignup(off+hint, lfs->cfg->read_size),
-                lfs->cfg->cache_size);
-        int err = lfs_dir_getslice(lfs, dir, gmask, gtag,
-                rcache->off, rcache->buffer, rcache->size);
-        if (err < 0) {
-            return err;
-        }
-    }
-
-    return 0;
-}
-
 static int lfs_dir_traverse_filter(void *p,
         lfs_tag_t tag, const void *buffer) {
     lfs_tag_t *filtertag = p;
@@ -733,6 +890,46 @@ static int lfs_dir_traverse(lfs_t *lfs,
             if (err) {
                 return err;
             }
+
+            // file data kept in the metadata log moves with the file, this
+            // is any inline chunks or journaled appends
+            err = lfs_dir_traverse(lfs,
+                    buffer, 0, LFS_BLOCK_NULL, NULL, 0, true,
+                    LFS_MKTAG(0x700, 0x3ff, 0),
+                    LFS_MKTAG(LFS_TYPE_FROM, 0, 0),
+                    fromid, fromid+1, toid-fromid+diff,
+                    cb, data);
+            if (err) {
+                return err;
+            }
+        } else if (lfs_tag_type3(tag) == LFS_FROM_INLINE) {
+            // write out the rest of an inline file that doesn't fit in its
+            // struct, a file ending on a chunk boundary gets an empty chunk
+            // so stale chunks past it, possibly left by a mount with a larger
+            // inline_max, are never read, any other chunks we may have used
+            // are deleted
+            const lfs_file_t *file = buffer;
+            lfs_size_t size = (file->flags & LFS_F_INLINE)
+                    ? file->ctz.size : 0;
+            for (unsigned k = 0; k < lfs_tag_size(tag); k++) {
+                lfs_off_t coff = (k+1)*0x3fe;
+                int err = 0;
+                if (coff < size) {
+                    err = cb(data, LFS_MKTAG(LFS_TYPE_INLINECHUNK + k,
+                            lfs_tag_id(tag) + diff,
+                            lfs_min(size - coff, 0x3fe)),
+                            &file->cache.buffer[coff]);
+                } else if (coff == size) {
+                    err = cb(data, LFS_MKTAG(LFS_TYPE_INLINECHUNK + k,
+                            lfs_tag_id(tag) + diff, 0), NULL);
+                } else if (coff < lfs->inline_max) {
+                    err = cb(data, LFS_MKTAG(LFS_TYPE_INLINECHUNK + k,
+                            lfs_tag_id(tag) + diff, 0x3ff), NULL);
+                }
+                if (err) {
+                    return err;
+                }
+            }
         } else if (lfs_tag_type3(tag) == LFS_FROM_USERATTRS) {
             for (unsigned i = 0; i < lfs_tag_size(tag); i++) {
                 const struct lfs_attr *a = buffer;
@@ -1004,6 +1201,60 @@ static int lfs_dir_getgstate(lfs_t *lfs, const lfs_mdir_t *dir,
     return 0;
 }
 
+static lfs_stag_t lfs_dir_getctz(lfs_t *lfs, const lfs_mdir_t *dir,
+        uint16_t id, struct lfs_ctz *ctz) {
+    uint32_t buffer[LFS_CTZ_WORDS];
+    lfs_stag_t tag = lfs_dir_get(lfs, dir, LFS_MKTAG(0x700, 0x3ff, 0),
+            LFS_MKTAG(LFS_TYPE_STRUCT, id, sizeof(buffer)), buffer);
+    if (tag < 0) {
+        return tag;
+    }
+
+    int err = lfs_ctz_fromdisk(tag, buffer, ctz);
+    if (err) {
+        return err;
+    }
+
+    if (lfs_ctz_patchcount(tag) > ctz->pcount) {
+        // more patches than we can keep track of
+        return LFS_ERR_FBIG;
+    }
+
+    return tag;
+}
+
+static lfs_ssize_t lfs_dir_getinline(lfs_t *lfs, const lfs_mdir_t *dir,
+        uint16_t id, void *buffer, lfs_size_t size) {
+    // inline files larger than a single tag continue in chunks, every
+    // tag but the last is full, the last may be empty
+    uint8_t *data = buffer;
+    lfs_size_t total = 0;
+    lfs_tag_t gtag = LFS_MKTAG(LFS_TYPE_INLINESTRUCT, id, 0);
+    for (uint16_t k = 0; k <= 0x40; k++) {
+        lfs_size_t diff = lfs_min(size, 0x3fe);
+        lfs_stag_t tag = lfs_dir_getslice(lfs, dir,
+                LFS_MKTAG(0x7ff, 0x3ff, 0), gtag, 0, data, diff);
+        if (tag < 0) {
+            if (tag == LFS_ERR_NOENT && k > 0) {
+                break;
+            }
+            return tag;
+        }
+
+        diff = lfs_min(diff, lfs_tag_size(tag));
+        data += diff;
+        size -= diff;
+        total += lfs_tag_size(tag);
+        if (lfs_tag_size(tag) < 0x3fe) {
+            break;
+        }
+
+        gtag = LFS_MKTAG(LFS_TYPE_INLINECHUNK + k, id, 0);
+    }
+
+    return total;
+}
+
 static int lfs_dir_getinfo(lfs_t *lfs, lfs_mdir_t *dir,
         uint16_t id, struct lfs_info *info) {
     if (id == 0x3ff) {
@@ -1022,17 +1273,23 @@ static int lfs_dir_getinfo(lfs_t *lfs, lfs_mdir_t *dir,
     info->type = lfs_tag_type3(tag);
 
     struct lfs_ctz ctz;
-    tag = lfs_dir_get(lfs, dir, LFS_MKTAG(0x700, 0x3ff, 0),
-            LFS_MKTAG(LFS_TYPE_STRUCT, id, sizeof(ctz)), &ctz);
+    tag = lfs_dir_getctz(lfs, dir, id, &ctz);
     if (tag < 0) {
         return (int)tag;
     }
-    lfs_ctz_fromle32(&ctz);
 
-    if (lfs_tag_type3(tag) == LFS_TYPE_CTZSTRUCT) {
-        info->size = ctz.size;
+    if (lfs_tag_isctz(tag)) {
+        info->size = ctz.size + ctz.hole + ctz.journal - ctz.start;
     } else if (lfs_tag_type3(tag) == LFS_TYPE_INLINESTRUCT) {
         info->size = lfs_tag_size(tag);
+        if (info->size == 0x3fe) {
+            // may continue in more tags
+            lfs_ssize_t res = lfs_dir_getinline(lfs, dir, id, NULL, 0);
+            if (res < 0) {
+                return res;
+            }
+            info->size = res;
+        }
     }
 
     return 0;
@@ -1068,6 +1325,155 @@ static int lfs_dir_find_match(void *data,
     return LFS_CMP_EQ;
 }
 
+// keys that sort before or after any name
+#define LFS_INDEX_MIN ((lfs_size_t)-2)
+#define LFS_INDEX_MAX ((lfs_size_t)-1)
+
+static int lfs_index_cmp(const lfs_index_entry_t *entry,
+        const void *name, lfs_size_t size) {
+    if (entry->size == LFS_INDEX_MIN) {
+        return LFS_CMP_LT;
+    } else if (entry->size == LFS_INDEX_MAX) {
+        return LFS_CMP_GT;
+    }
+
+    // same order as lfs_dir_find_match, but only as far as the key goes
+    size = lfs_min(size, LFS_INDEX_KEY);
+    int res = memcmp(entry->key, name, lfs_min(entry->size, size));
+    if (res != 0) {
+        return (res < 0) ? LFS_CMP_LT : LFS_CMP_GT;
+    }
+
+    if (entry->size != size) {
+        return (size < entry->size) ? LFS_CMP_LT : LFS_CMP_GT;
+    }
+
+    return LFS_CMP_EQ;
+}
+
+static int lfs_index_build(lfs_t *lfs,
+        const lfs_block_t head[2], lfs_index_entry_t **record) {
+    // a record is a header holding the directory's head and number of
+    // pairs, followed by each pair and the key of its last name
+    lfs_size_t off = lfs->index.off;
+    if (lfs->index.size - off < 3) {
+        off = 0;
+    }
+
+    if (lfs->index.size - off < 3) {
+        // too small to be useful
+        *record = NULL;
+        return 0;
+    }
+
+    lfs_index_entry_t *r = &lfs->index.buffer[off];
+    r->pair[0] = head[0];
+    r->pair[1] = head[1];
+    r->size = 0;
+
+    lfs_mdir_t m = {.tail = {head[0], head[1]}};
+    while (true) {
+        int err = lfs_dir_fetch(lfs, &m, m.tail);
+        if (err) {
+            return err;
+        }
+
+        lfs_index_entry_t *entry = &r[1+r->size];
+        entry->pair[0] = m.pair[0];
+        entry->pair[1] = m.pair[1];
+        entry->size = LFS_INDEX_MAX;
+        r->size += 1;
+
+        // last pair always takes the rest of the names
+        if (!m.split) {
+            break;
+        }
+
+        if (m.count == 0) {
+            entry->size = LFS_INDEX_MIN;
+        } else if (!lfs_gstate_hasmovehere(&lfs->gstate, m.pair)) {
+            // names are sorted across the pairs of a directory, so the
+            // last name is an upper bound for the pair
+            lfs_stag_t tag = lfs_dir_get(lfs, &m, LFS_MKTAG(0x780, 0x3ff, 0),
+                    LFS_MKTAG(LFS_TYPE_NAME, m.count-1, LFS_INDEX_KEY),
+                    entry->key);
+            if (tag < 0 && tag != LFS_ERR_NOENT) {
+                return tag;
+            }
+
+            if (tag >= 0) {
+                entry->size = lfs_min(lfs_tag_size(tag), LFS_INDEX_KEY);
+            }
+        }
+
+        // out of space? make room by dropping older records, otherwise
+        // index what we can and let lookups walk the rest
+        if (off + 1+r->size >= lfs->index.size) {
+            if (off == 0) {
+                entry->size = LFS_INDEX_MAX;
+                break;
+            }
+
+            memmove(lfs->index.buffer, r, (1+r->size)*sizeof(*r));
+            off = 0;
+            r = lfs->index.buffer;
+        }
+    }
+
+    lfs->index.off = off + 1+r->size;
+    *record = r;
+    return 0;
+}
+
+static int lfs_index_find(lfs_t *lfs, const lfs_block_t head[2],
+        lfs_block_t pair[2], const char *name, lfs_size_t namelen) {
+    if (lfs->index.size == 0) {
+        return 0;
+    }
+
+    // find or build the directory's record
+    lfs_index_entry_t *r = NULL;
+    for (lfs_size_t i = 0; i < lfs->index.off;
+            i += 1+lfs->index.buffer[i].size) {
+        if (lfs_pair_cmp(lfs->index.buffer[i].pair, head) == 0) {
+            r = &lfs->index.buffer[i];
+            break;
+        }
+    }
+
+    if (!r) {
+        int err = lfs_index_build(lfs, head, &r);
+        if (err) {
+            return err;
+        }
+
+        if (!r) {
+            return 0;
+        }
+    }
+
+    // find the first pair whose last name is not less than ours
+    lfs_size_t lo = 1;
+    lfs_size_t hi = 1+r->size;
+    while (lo < hi) {
+        lfs_size_t mid = lo + (hi-lo)/2;
+        if (lfs_index_cmp(&r[mid], name, namelen) == LFS_CMP_LT) {
+            lo = mid+1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // if this is the head we already searched, the name may still be in a
+    // pair split off of it, so just keep walking
+    if (lo > 1) {
+        pair[0] = r[lo].pair[0];
+        pair[1] = r[lo].pair[1];
+    }
+
+    return 0;
+}
+
 static lfs_stag_t lfs_dir_find(lfs_t *lfs, lfs_mdir_t *dir,
         const char **path, uint16_t *id) {
     // we reduce path to a single name if we can find it
@@ -1142,6 +1548,8 @@ nextname:
         }
 
         // find entry matching name
+        const lfs_block_t head[2] = {dir->tail[0], dir->tail[1]};
+        bool indexed = false;
         while (true) {
             tag = lfs_dir_fetchmatch(lfs, dir, dir->tail,
                     LFS_MKTAG(0x780, 0, 0),
@@ -1161,6 +1569,16 @@ nextname:
             if (!dir->split) {
                 return LFS_ERR_NOENT;
             }
+
+            // large directory? let the index pick the next pair
+            if (!indexed) {
+                int err = lfs_index_find(lfs, head, dir->tail, name, namelen);
+                if (err) {
+                    return err;
+                }
+
+                indexed = true;
+            }
         }
 
         // to next name
@@ -1285,8 +1703,11 @@ static int lfs_dir_commitcrc(lfs_t *lfs, struct lfs_commit *commit) {
         commit->crc = LFS_BLOCK_NULL; // reset crc for next "commit"
     }
 
-    // flush buffers
-    int err = lfs_bd_sync(lfs, &lfs->pcache, &lfs->rcache, false);
+    // flush buffers, lfs_fs_sync may defer the device sync to the end
+    lfs_cache_drop(lfs, &lfs->rcache);
+    int err = (lfs->flags & LFS_M_NOSYNC)
+            ? lfs_bd_flush(lfs, &lfs->pcache, &lfs->rcache, false)
+            : lfs_bd_sync(lfs, &lfs->pcache, &lfs->rcache, false);
     if (err) {
         return err;
     }
@@ -1344,8 +1765,12 @@ static int lfs_dir_alloc(lfs_t *lfs, lfs_mdir_t *dir) {
         return err;
     }
 
-    // make sure we don't immediately evict
-    dir->rev += dir->rev & 1;
+    // make sure we don't immediately evict, aligning to our block_cycles
+    // modulus means the first compaction never checks for eviction, which
+    // would traverse whatever stale filesystem is on disk during format
+    if (lfs->cfg->block_cycles > 0) {
+        dir->rev = lfs_alignup(dir->rev, lfs->cfg->block_cycles+1);
+    }
 
     // set defaults
     dir->off = sizeof(dir->rev);
@@ -1456,7 +1881,7 @@ static int lfs_dir_compact(lfs_t *lfs,
         // cleanup delete, and we cap at half a block to give room
         // for metadata updates.
         if (end - begin < 0xff &&
-                size <= lfs_min(lfs->cfg->block_size - 36,
+                size <= lfs_min(lfs->cfg->block_size - 40,
                     lfs_alignup(lfs->cfg->block_size/2,
                         lfs->cfg->prog_size))) {
             break;
@@ -1472,7 +1897,7 @@ static int lfs_dir_compact(lfs_t *lfs,
             // if we fail to split, we may be able to overcompact, unless
             // we're too big for even the full block, in which case our
             // only option is to error
-            if (err == LFS_ERR_NOSPC && size <= lfs->cfg->block_size - 36) {
+            if (err == LFS_ERR_NOSPC && size <= lfs->cfg->block_size - 40) {
                 break;
             }
             return err;
@@ -1613,6 +2038,26 @@ static int lfs_dir_compact(lfs_t *lfs,
                 }
             }
 
+            // a checkpoint has no id, but it is only ever committed by
+            // itself, so carry it over stamped with our new revision
+            for (int i = 0; i < attrcount; i++) {
+                if (lfs_tag_type3(attrs[i].tag) != LFS_TYPE_CHECKPOINT ||
+                        lfs_tag_isdelete(attrs[i].tag)) {
+                    continue;
+                }
+
+                struct lfs_checkpoint ckpt;
+                memcpy(&ckpt, attrs[i].buffer, sizeof(ckpt));
+                ckpt.rev = lfs_tole32(dir->rev);
+                err = lfs_dir_commitattr(lfs, &commit, attrs[i].tag, &ckpt);
+                if (err) {
+                    if (err == LFS_ERR_CORRUPT) {
+                        goto relocate;
+                    }
+                    return err;
+                }
+            }
+
             err = lfs_dir_commitcrc(lfs, &commit);
             if (err) {
                 if (err == LFS_ERR_CORRUPT) {
@@ -1675,12 +2120,17 @@ relocate:
 
 static int lfs_dir_commit(lfs_t *lfs, lfs_mdir_t *dir,
         const struct lfs_mattr *attrs, int attrcount) {
+    // any checkpoint must be dropped and the version updated before we
+    // start changing things
+    LFS_ASSERT(!(lfs->flags &
+            (LFS_M_HASCKPT | LFS_M_UNSCANNED | LFS_M_OUTDATED)));
+
     // check for any inline files that aren't RAM backed and
     // forcefully evict them, needed for filesystem consistency
     for (lfs_file_t *f = (lfs_file_t*)lfs->mlist; f; f = f->next) {
         if (dir != &f->m && lfs_pair_cmp(f->m.pair, dir->pair) == 0 &&
                 f->type == LFS_TYPE_REG && (f->flags & LFS_F_INLINE) &&
-                f->ctz.size > lfs->cfg->cache_size) {
+                f->ctz.size > lfs_max(lfs->cfg->cache_size, lfs->inline_max)) {
             int err = lfs_file_outline(lfs, f);
             if (err) {
                 return err;
@@ -1694,11 +2144,10 @@ static int lfs_dir_commit(lfs_t *lfs, lfs_mdir_t *dir,
     }
 
     // calculate changes to the directory
+    lfs_tag_t movetag = LFS_BLOCK_NULL;
     lfs_tag_t deletetag = LFS_BLOCK_NULL;
-    lfs_tag_t createtag = LFS_BLOCK_NULL;
     for (int i = 0; i < attrcount; i++) {
         if (lfs_tag_type3(attrs[i].tag) == LFS_TYPE_CREATE) {
-            createtag = attrs[i].tag;
             dir->count += 1;
         } else if (lfs_tag_type3(attrs[i].tag) == LFS_TYPE_DELETE) {
             deletetag = attrs[i].tag;
@@ -1709,12 +2158,16 @@ static int lfs_dir_commit(lfs_t *lfs, lfs_mdir_t *dir,
             dir->tail[1] = ((lfs_block_t*)attrs[i].buffer)[1];
             dir->split = (lfs_tag_chunk(attrs[i].tag) & 1);
             lfs_pair_fromle32(dir->tail);
+
+            // the threaded list is changing, drop the directory index
+            lfs->index.off = 0;
         }
     }
 
     // do we have a pending move?
     if (lfs_gstate_hasmovehere(&lfs->gpending, dir->pair)) {
-        deletetag = lfs->gpending.tag & LFS_MKTAG(0x7ff, 0x3ff, 0);
+        movetag = lfs->gpending.tag & LFS_MKTAG(0x7ff, 0x3ff, 0);
+        deletetag = movetag;
         LFS_ASSERT(dir->count > 0);
         dir->count -= 1;
 
@@ -1806,7 +2259,9 @@ static int lfs_dir_commit(lfs_t *lfs, lfs_mdir_t *dir,
         lfs->gdelta = (struct lfs_gstate){0};
     } else {
 compact:
-        // fall back to compaction
+        // fall back to compaction, other pairs may come to depend on
+        // this so always sync
+        lfs->flags &= ~LFS_M_NOSYNC;
         lfs_cache_drop(lfs, &lfs->pcache);
 
         int err = lfs_dir_compact(lfs, dir, attrs, attrcount,
@@ -1824,18 +2279,28 @@ compact:
     for (struct lfs_mlist *d = lfs->mlist; d; d = d->next) {
         if (lfs_pair_cmp(d->m.pair, copy.pair) == 0) {
             d->m = *dir;
-            if (d->id == lfs_tag_id(deletetag)) {
-                d->m.pair[0] = LFS_BLOCK_NULL;
-                d->m.pair[1] = LFS_BLOCK_NULL;
-            } else if (d->id > lfs_tag_id(deletetag)) {
-                d->id -= 1;
-                if (d->type == LFS_TYPE_DIR) {
-                    ((lfs_dir_t*)d)->pos -= 1;
-                }
-            } else if (&d->m != dir && d->id >= lfs_tag_id(createtag)) {
-                d->id += 1;
-                if (d->type == LFS_TYPE_DIR) {
-                    ((lfs_dir_t*)d)->pos += 1;
+
+            // replay creates and deletes in order, a pending move is
+            // resolved after everything else
+            for (int i = 0; i <= attrcount; i++) {
+                lfs_tag_t tag = (i < attrcount) ? attrs[i].tag : movetag;
+                if (lfs_tag_type3(tag) == LFS_TYPE_DELETE &&
+                        d->id == lfs_tag_id(tag)) {
+                    d->m.pair[0] = LFS_BLOCK_NULL;
+                    d->m.pair[1] = LFS_BLOCK_NULL;
+                    break;
+                } else if (lfs_tag_type3(tag) == LFS_TYPE_DELETE &&
+                        d->id > lfs_tag_id(tag)) {
+                    d->id -= 1;
+                    if (d->type == LFS_TYPE_DIR) {
+                        ((lfs_dir_t*)d)->pos -= 1;
+                    }
+                } else if (lfs_tag_type3(tag) == LFS_TYPE_CREATE &&
+                        &d->m != dir && d->id >= lfs_tag_id(tag)) {
+                    d->id += 1;
+                    if (d->type == LFS_TYPE_DIR) {
+                        ((lfs_dir_t*)d)->pos += 1;
+                    }
                 }
             }
 
@@ -2060,6 +2525,258 @@ int lfs_dir_read(lfs_t *lfs, lfs_dir_t *dir, struct lfs_info *info) {
     return true;
 }
 
+static bool lfs_dir_readbulk_alloc(lfs_size_t base, lfs_size_t *hoff,
+        lfs_size_t *count, lfs_size_t k, lfs_size_t size) {
+    // try to allocate from the top of the buffer for entry k, giving up
+    // later entries if we need to
+    for (lfs_size_t n = *count; n > k; n--) {
+        if (*hoff >= size &&
+                *hoff - size >= base + n*sizeof(struct lfs_dirent)) {
+            *hoff -= size;
+            *count = n;
+            return true;
+        }
+    }
+
+    *count = k;
+    return false;
+}
+
+static lfs_ssize_t lfs_dir_readbulkpair(lfs_t *lfs, lfs_dir_t *dir,
+        void *buffer, lfs_size_t hoff, int attr, lfs_size_t *count) {
+    struct lfs_dirent *ents = buffer;
+    while (dir->id == dir->m.count) {
+        if (!dir->m.split) {
+            return 0;
+        }
+
+        int err = lfs_dir_fetch(lfs, &dir->m, dir->m.tail);
+        if (err) {
+            return err;
+        }
+
+        dir->id = 0;
+    }
+
+    // one slot for each id left in the pair, assuming short names, we give
+    // up slots later if names don't fit
+    lfs_size_t base = *count*sizeof(struct lfs_dirent);
+    lfs_size_t n = (hoff - base) /
+            (sizeof(struct lfs_dirent) + sizeof(uint16_t) + 8);
+    if (n == 0 && hoff - base >=
+            sizeof(struct lfs_dirent) + 2*sizeof(uint16_t)) {
+        n = 1;
+    }
+    n = lfs_min(n, dir->m.count - dir->id);
+    if (n == 0) {
+        return 0;
+    }
+
+    // keep track of each slot's id as we go back through the log, ids
+    // of 0xffff have been created and can't be found any further back
+    hoff = (hoff - n*sizeof(uint16_t)) & ~(lfs_size_t)(sizeof(uint16_t)-1);
+    uint16_t *ids = (uint16_t*)((uint8_t*)buffer + hoff);
+    struct lfs_dirent *slots = &ents[*count];
+    for (lfs_size_t k = 0; k < n; k++) {
+        slots[k] = (struct lfs_dirent){
+                0, (lfs_foff_t)-1, NULL, NULL, LFS_BLOCK_NULL};
+        ids[k] = dir->id + k;
+        if (lfs_gstate_hasmovehere(&lfs->gstate, dir->m.pair) &&
+                lfs_tag_id(lfs->gstate.tag) <= ids[k]) {
+            // synthetic moves
+            ids[k] += 1;
+        }
+    }
+
+    // iterate over dir block backwards, same as lfs_dir_getslice but
+    // looking for every slot at once
+    lfs_off_t off = dir->m.off;
+    lfs_tag_t ntag = dir->m.etag;
+    bool found = false;
+    while (!found && off >= sizeof(lfs_tag_t) + lfs_tag_dsize(ntag)) {
+        off -= lfs_tag_dsize(ntag);
+        lfs_tag_t tag = ntag;
+        int err = lfs_bd_read(lfs,
+                NULL, &lfs->rcache, sizeof(ntag),
+                dir->m.pair[0], off, &ntag, sizeof(ntag));
+        if (err) {
+            return err;
+        }
+
+        ntag = (lfs_frombe32(ntag) ^ tag) & 0x7fffffff;
+
+        found = true;
+        for (lfs_size_t k = 0; k < n; k++) {
+            if (ids[k] == 0xffff) {
+                continue;
+            }
+
+            if (lfs_tag_type1(tag) == LFS_TYPE_SPLICE &&
+                    lfs_tag_id(tag) <= ids[k]) {
+                if (tag == LFS_MKTAG(LFS_TYPE_CREATE, ids[k], 0)) {
+                    // found where we were created
+                    ids[k] = 0xffff;
+                    continue;
+                }
+
+                // move around splices
+                ids[k] -= lfs_tag_splice(tag);
+            } else if (lfs_tag_id(tag) == ids[k] &&
+                    (LFS_MKTAG(0x780, 0, 0) & tag) ==
+                        LFS_MKTAG(LFS_TYPE_NAME, 0, 0) &&
+                    !slots[k].name) {
+                lfs_size_t nlen = lfs_tag_size(tag);
+                if (!lfs_dir_readbulk_alloc(base, &hoff, &n, k, nlen+1)) {
+                    break;
+                }
+
+                char *name = (char*)buffer + hoff;
+                err = lfs_bd_read(lfs,
+                        NULL, &lfs->rcache, nlen,
+                        dir->m.pair[0], off+sizeof(tag), name, nlen);
+                if (err) {
+                    return err;
+                }
+
+                name[nlen] = '\0';
+                slots[k].type = lfs_tag_type3(tag);
+                slots[k].name = name;
+            } else if (lfs_tag_id(tag) == ids[k] &&
+                    lfs_tag_type1(tag) == LFS_TYPE_STRUCT &&
+                    slots[k].size == (lfs_foff_t)-1) {
+                slots[k].size = 0;
+                if (lfs_tag_isctz(tag)) {
+                    uint32_t dctz[LFS_CTZ_WORDS] = {0};
+                    lfs_size_t csize = lfs_min(lfs_tag_size(tag),
+                            sizeof(dctz));
+                    err = lfs_bd_read(lfs,
+                            NULL, &lfs->rcache, csize,
+                            dir->m.pair[0], off+sizeof(tag),
+                            dctz, csize);
+                    if (err) {
+                        return err;
+                    }
+                    struct lfs_ctz ctz;
+                    err = lfs_ctz_fromdisk(tag, dctz, &ctz);
+                    if (err) {
+                        return err;
+                    }
+                    slots[k].size = ctz.size + ctz.hole + ctz.journal
+                            - ctz.start;
+                } else if (lfs_tag_type3(tag) == LFS_TYPE_INLINESTRUCT) {
+                    slots[k].size = lfs_tag_size(tag);
+                    if (slots[k].size == 0x3fe) {
+                        // may continue in more tags
+                        lfs_ssize_t res = lfs_dir_getinline(lfs, &dir->m,
+                                dir->id + k, NULL, 0);
+                        if (res < 0) {
+                            return res;
+                        }
+                        slots[k].size = res;
+                    }
+                }
+            } else if (lfs_tag_id(tag) == ids[k] && attr >= 0 &&
+                    lfs_tag_type3(tag) == LFS_TYPE_USERATTR + attr &&
+                    slots[k].attr_size == LFS_BLOCK_NULL) {
+                slots[k].attr_size = 0;
+                if (!lfs_tag_isdelete(tag)) {
+                    lfs_size_t asize = lfs_tag_size(tag);
+                    if (!lfs_dir_readbulk_alloc(
+                            base, &hoff, &n, k, asize)) {
+                        break;
+                    }
+
+                    err = lfs_bd_read(lfs,
+                            NULL, &lfs->rcache, asize,
+                            dir->m.pair[0], off+sizeof(tag),
+                            (uint8_t*)buffer + hoff, asize);
+                    if (err) {
+                        return err;
+                    }
+
+                    slots[k].attr = (uint8_t*)buffer + hoff;
+                    slots[k].attr_size = asize;
+                }
+            }
+
+            // still looking?
+            if (!(slots[k].name &&
+                    slots[k].size != (lfs_foff_t)-1 &&
+                    (attr < 0 || slots[k].attr_size != LFS_BLOCK_NULL))) {
+                found = false;
+            }
+        }
+    }
+
+    // pack found entries, anything without a name doesn't exist
+    for (lfs_size_t k = 0; k < n; k++) {
+        if (slots[k].name) {
+            ents[*count] = slots[k];
+            if (ents[*count].size == (lfs_foff_t)-1) {
+                ents[*count].size = 0;
+            }
+
+            if (ents[*count].attr_size == LFS_BLOCK_NULL) {
+                ents[*count].attr_size = 0;
+            }
+
+            *count += 1;
+            dir->pos += 1;
+        }
+    }
+
+    dir->id += n;
+    return n;
+
+}
+
+lfs_ssize_t lfs_dir_readbulk(lfs_t *lfs, lfs_dir_t *dir,
+        void *buffer, lfs_size_t size, int attr) {
+    LFS_TRACE("lfs_dir_readbulk(%p, %p, %p, %"PRIu32", %d)",
+            (void*)lfs, (void*)dir, buffer, size, attr);
+    struct lfs_dirent *ents = buffer;
+    lfs_size_t count = 0;
+    lfs_size_t hoff = size;
+
+    // special offset for '.' and '..'
+    while (dir->pos < 2) {
+        lfs_size_t n = count+1;
+        if (!lfs_dir_readbulk_alloc(0, &hoff, &n, count, dir->pos+2)) {
+            break;
+        }
+
+        char *name = (char*)buffer + hoff;
+        strcpy(name, (dir->pos == 0) ? "." : "..");
+        ents[count] = (struct lfs_dirent){LFS_TYPE_DIR, 0, name, NULL, 0};
+        count += 1;
+        dir->pos += 1;
+    }
+
+    // read one pair, unless it has nothing to show us
+    while (dir->pos >= 2) {
+        lfs_ssize_t res = lfs_dir_readbulkpair(lfs, dir,
+                buffer, hoff, attr, &count);
+        if (res < 0) {
+            LFS_TRACE("lfs_dir_readbulk -> %"PRId32, res);
+            return res;
+        }
+
+        if (res == 0 || count > 0) {
+            break;
+        }
+    }
+
+    if (count == 0 && !(dir->pos >= 2 &&
+            dir->id == dir->m.count && !dir->m.split)) {
+        // couldn't fit anything
+        LFS_TRACE("lfs_dir_readbulk -> %d", LFS_ERR_NOSPC);
+        return LFS_ERR_NOSPC;
+    }
+
+    LFS_TRACE("lfs_dir_readbulk -> %"PRId32, count);
+    return count;
+}
+
 int lfs_dir_seek(lfs_t *lfs, lfs_dir_t *dir, lfs_off_t off) {
     LFS_TRACE("lfs_dir_seek(%p, %p, %"PRIu32")",
             (void*)lfs, (void*)dir, off);
@@ -2110,6 +2827,67 @@ lfs_soff_t lfs_dir_tell(lfs_t *lfs, lfs_dir_t *dir) {
     return dir->pos;
 }
 
+int lfs_dir_tellcookie(lfs_t *lfs, lfs_dir_t *dir,
+        struct lfs_dircookie *cookie) {
+    LFS_TRACE("lfs_dir_tellcookie(%p, %p, %p)",
+            (void*)lfs, (void*)dir, (void*)cookie);
+    (void)lfs;
+    cookie->head[0] = dir->head[0];
+    cookie->head[1] = dir->head[1];
+    cookie->pair[0] = dir->m.pair[0];
+    cookie->pair[1] = dir->m.pair[1];
+    cookie->rev = dir->m.rev;
+    cookie->off = dir->m.off;
+    cookie->id = dir->id;
+    cookie->pos = dir->pos;
+    LFS_TRACE("lfs_dir_tellcookie -> %d", 0);
+    return 0;
+}
+
+int lfs_dir_seekcookie(lfs_t *lfs, lfs_dir_t *dir,
+        const struct lfs_dircookie *cookie) {
+    LFS_TRACE("lfs_dir_seekcookie(%p, %p, %p {.pair={%"PRIx32", %"PRIx32"}, "
+                ".rev=%"PRIx32", .id=%"PRIu16", .pos=%"PRIu32"})",
+            (void*)lfs, (void*)dir, (void*)cookie,
+            cookie->pair[0], cookie->pair[1], cookie->rev,
+            cookie->id, cookie->pos);
+    if (lfs_pair_cmp(cookie->head, dir->head) != 0) {
+        LFS_TRACE("lfs_dir_seekcookie -> %d", LFS_ERR_INVAL);
+        return LFS_ERR_INVAL;
+    }
+
+    if (cookie->pos >= 2 &&
+            cookie->pair[0] < lfs->cfg->block_count &&
+            cookie->pair[1] < lfs->cfg->block_count) {
+        // if nothing has been committed to the pair since, the ids are
+        // unchanged and we can jump straight there
+        lfs_mdir_t m;
+        int err = lfs_dir_fetch(lfs, &m, cookie->pair);
+        if (err && err != LFS_ERR_CORRUPT) {
+            LFS_TRACE("lfs_dir_seekcookie -> %d", err);
+            return err;
+        }
+
+        if (!err &&
+                m.pair[0] == cookie->pair[0] &&
+                m.pair[1] == cookie->pair[1] &&
+                m.rev == cookie->rev &&
+                m.off == cookie->off &&
+                cookie->id <= m.count) {
+            dir->m = m;
+            dir->id = cookie->id;
+            dir->pos = cookie->pos;
+            LFS_TRACE("lfs_dir_seekcookie -> %d", 0);
+            return 0;
+        }
+    }
+
+    // stale cookie, walk from head dir
+    int err = lfs_dir_seek(lfs, dir, cookie->pos);
+    LFS_TRACE("lfs_dir_seekcookie -> %d", err);
+    return err;
+}
+
 int lfs_dir_rewind(lfs_t *lfs, lfs_dir_t *dir) {
     LFS_TRACE("lfs_dir_rewind(%p, %p)", (void*)lfs, (void*)dir);
     // reload the head dir
@@ -2127,36 +2905,113 @@ int lfs_dir_rewind(lfs_t *lfs, lfs_dir_t *dir) {
 
 
 /// File index list operations ///
-static int lfs_ctz_index(lfs_t *lfs, lfs_off_t *off) {
-    lfs_off_t size = *off;
-    lfs_off_t b = lfs->cfg->block_size - 2*4;
-    lfs_off_t i = size / b;
+static lfs_foff_t lfs_ctz_index(lfs_t *lfs, lfs_foff_t *off) {
+    lfs_foff_t size = *off;
+    lfs_foff_t b = lfs->cfg->block_size - 2*4;
+    lfs_foff_t i = size / b;
     if (i == 0) {
         return 0;
     }
 
-    i = (size - 4*(lfs_popc(i-1)+2)) / b;
-    *off = size - b*i - 4*lfs_popc(i);
+    i = (size - 4*(lfs_offpopc(i-1)+2)) / b;
+    *off = size - b*i - 4*lfs_offpopc(i);
     return i;
 }
 
+static void lfs_ctz_dropindex(struct lfs_ctzindex *index, lfs_foff_t i) {
+    // forget blocks at or after index i
+    for (lfs_size_t j = (i + (1 << index->shift)-1) >> index->shift;
+            j < index->size; j++) {
+        index->buffer[j] = LFS_BLOCK_NULL;
+    }
+}
+
+static lfs_block_t lfs_ctz_patched(lfs_t *lfs, const struct lfs_ctz *ctz,
+        lfs_foff_t pos, lfs_block_t block) {
+    // blocks replaced in place live in the patch table, the skip-list
+    // still points at the original block
+    if (ctz->pcount > 0) {
+        const struct lfs_ctzpatch *patch = LFS_CTZ_PATCH(ctz);
+        lfs_foff_t i = lfs_ctz_index(lfs, &pos);
+        for (lfs_size_t j = 0; j < ctz->pcount; j++) {
+            if (patch[j].index == i) {
+                return patch[j].block;
+            }
+        }
+    }
+
+    return block;
+}
+
+static void lfs_ctz_setpatch(struct lfs_ctz *ctz,
+        lfs_foff_t i, lfs_block_t block) {
+    // a new patch of the same block replaces the old one
+    struct lfs_ctzpatch *patch = LFS_CTZ_PATCH(ctz);
+    lfs_size_t j = 0;
+    while (j < ctz->pcount && patch[j].index != i) {
+        j += 1;
+    }
+
+    LFS_ASSERT(j+1 <= LFS_PATCH_MAX);
+    ctz->pcount = lfs_max(ctz->pcount, j+1);
+    patch[j].index = (lfs_block_t)i;
+    patch[j].block = block;
+}
+
+static void lfs_ctz_droppatch(struct lfs_ctz *ctz,
+        lfs_foff_t begin, lfs_foff_t end) {
+    // forget patches of blocks in [begin, end), either these blocks were
+    // rewritten or are no longer part of the file
+    struct lfs_ctzpatch *patch = LFS_CTZ_PATCH(ctz);
+    for (lfs_size_t j = 0; j < ctz->pcount;) {
+        if (patch[j].index >= begin && patch[j].index < end) {
+            ctz->pcount -= 1;
+            patch[j] = patch[ctz->pcount];
+        } else {
+            j += 1;
+        }
+    }
+}
+
 static int lfs_ctz_find(lfs_t *lfs,
         const lfs_cache_t *pcache, lfs_cache_t *rcache,
-        lfs_block_t head, lfs_size_t size,
-        lfs_size_t pos, lfs_block_t *block, lfs_off_t *off) {
+        struct lfs_ctzindex *index, lfs_block_t head, lfs_foff_t size,
+        lfs_foff_t pos, lfs_block_t *block, lfs_off_t *off) {
     if (size == 0) {
         *block = LFS_BLOCK_NULL;
         *off = 0;
         return 0;
     }
 
-    lfs_off_t current = lfs_ctz_index(lfs, &(lfs_off_t){size-1});
-    lfs_off_t target = lfs_ctz_index(lfs, &pos);
+    lfs_foff_t current = lfs_ctz_index(lfs, &(lfs_foff_t){size-1});
+    lfs_foff_t target = lfs_ctz_index(lfs, &pos);
+
+    if (index && index->size > 0) {
+        // file outgrew the index? keep every other entry
+        while ((current >> index->shift) >= index->size) {
+            for (lfs_size_t j = 0; j < index->size; j++) {
+                index->buffer[j] = (2*j < index->size)
+                        ? index->buffer[2*j]
+                        : LFS_BLOCK_NULL;
+            }
+            index->shift += 1;
+        }
+
+        // start from the closest known block at or after our target
+        for (lfs_size_t j = (target + (1 << index->shift)-1) >> index->shift;
+                j <= (current >> index->shift); j++) {
+            if (index->buffer[j] != LFS_BLOCK_NULL) {
+                head = index->buffer[j];
+                current = j << index->shift;
+                break;
+            }
+        }
+    }
 
     while (current > target) {
         lfs_size_t skip = lfs_min(
-                lfs_npw2(current-target+1) - 1,
-                lfs_ctz(current));
+                lfs_offnpw2(current-target+1) - 1,
+                lfs_offctz(current));
 
         int err = lfs_bd_read(lfs,
                 pcache, rcache, sizeof(head),
@@ -2167,7 +3022,13 @@ static int lfs_ctz_find(lfs_t *lfs,
         }
 
         LFS_ASSERT(head >= 2 && head <= lfs->cfg->block_count);
-        current -= 1 << skip;
+        current -= (lfs_foff_t)1 << skip;
+
+        // remember where we've been
+        if (index && index->size > 0 &&
+                (current & ((1 << index->shift)-1)) == 0) {
+            index->buffer[current >> index->shift] = head;
+        }
     }
 
     *block = head;
@@ -2175,21 +3036,84 @@ static int lfs_ctz_find(lfs_t *lfs,
     return 0;
 }
 
+static void lfs_ctz_push(struct lfs_ctzstack *stack,
+        lfs_foff_t index, lfs_block_t block, lfs_size_t levels) {
+    // remember the most recent block at each power-of-two boundary
+    for (lfs_size_t i = 0; i < lfs_min(levels, LFS_CTZ_DEPTH); i++) {
+        stack[i].index = index;
+        stack[i].block = block;
+    }
+}
+
+static void lfs_ctz_dropstack(struct lfs_ctzstack *stack, lfs_foff_t index) {
+    // forget any ancestors at or after index
+    for (int i = 0; i < LFS_CTZ_DEPTH; i++) {
+        if (stack[i].index >= index) {
+            stack[i].block = LFS_BLOCK_NULL;
+        }
+    }
+}
+
+static void lfs_ctz_movestack(struct lfs_ctzstack *stack,
+        lfs_block_t oblock, lfs_block_t nblock) {
+    for (int i = 0; i < LFS_CTZ_DEPTH; i++) {
+        if (stack[i].block == oblock) {
+            stack[i].block = nblock;
+        }
+    }
+}
+
+static inline struct lfs_ctzstack *lfs_file_stack(lfs_file_t *file) {
+#if LFS_CTZ_DEPTH > 0
+    return file->stack;
+#else
+    // no stack, every append reads back its pointers
+    (void)file;
+    return NULL;
+#endif
+}
+
+static inline lfs_foff_t lfs_ctz_first(lfs_t *lfs, lfs_foff_t start) {
+    // first block still in use after dropping data from the front of a
+    // file, we keep the block before our start so the file can still be
+    // extended from its first byte
+    return (start > 0) ? lfs_ctz_index(lfs, &(lfs_foff_t){start-1}) : 0;
+}
+
+static int lfs_ctz_alloc(lfs_t *lfs, struct lfs_ctzreserve *reserve,
+        lfs_block_t *block, bool *erased) {
+    // use up any blocks reserved for the file before asking the allocator
+    if (reserve && reserve->count > 0) {
+        reserve->count -= 1;
+        *block = reserve->buffer[reserve->count];
+        *erased = reserve->erased;
+        return 0;
+    }
+
+    *erased = false;
+    return lfs_alloc(lfs, block);
+}
+
 static int lfs_ctz_extend(lfs_t *lfs,
         lfs_cache_t *pcache, lfs_cache_t *rcache,
-        lfs_block_t head, lfs_size_t size,
+        struct lfs_ctzstack *stack, struct lfs_ctzreserve *reserve,
+        lfs_block_t head, lfs_foff_t start, lfs_foff_t size,
         lfs_block_t *block, lfs_off_t *off) {
+    lfs_foff_t first = lfs_ctz_first(lfs, start);
+    // levels we can remember, none without a stack
+    lfs_size_t depth = (stack) ? LFS_CTZ_DEPTH : 0;
     while (true) {
         // go ahead and grab a block
         lfs_block_t nblock;
-        int err = lfs_alloc(lfs, &nblock);
+        bool erased;
+        int err = lfs_ctz_alloc(lfs, reserve, &nblock, &erased);
         if (err) {
             return err;
         }
         LFS_ASSERT(nblock >= 2 && nblock <= lfs->cfg->block_count);
 
         {
-            err = lfs_bd_erase(lfs, nblock);
+            err = erased ? 0 : lfs_bd_erase(lfs, nblock);
             if (err) {
                 if (err == LFS_ERR_CORRUPT) {
                     goto relocate;
@@ -2198,35 +3122,34 @@ static int lfs_ctz_extend(lfs_t *lfs,
             }
 
             if (size == 0) {
+                if (stack) {
+                    lfs_ctz_push(stack, 0, nblock, LFS_CTZ_DEPTH);
+                }
+
                 *block = nblock;
                 *off = 0;
                 return 0;
             }
 
             size -= 1;
-            lfs_off_t index = lfs_ctz_index(lfs, &size);
+            lfs_foff_t index = lfs_ctz_index(lfs, &size);
             size += 1;
 
             // just copy out the last block if it is incomplete
             if (size != lfs->cfg->block_size) {
-                for (lfs_off_t i = 0; i < size; i++) {
-                    uint8_t data;
-                    err = lfs_bd_read(lfs,
-                            NULL, rcache, size-i,
-                            head, i, &data, 1);
-                    if (err) {
-                        return err;
+                err = lfs_bd_copy(lfs,
+                        pcache, rcache, true,
+                        nblock, 0, NULL, head, 0, size);
+                if (err) {
+                    if (err == LFS_ERR_CORRUPT) {
+                        goto relocate;
                     }
+                    return err;
+                }
 
-                    err = lfs_bd_prog(lfs,
-                            pcache, rcache, true,
-                            nblock, i, &data, 1);
-                    if (err) {
-                        if (err == LFS_ERR_CORRUPT) {
-                            goto relocate;
-                        }
-                        return err;
-                    }
+                if (stack) {
+                    lfs_ctz_push(stack, index, nblock,
+                            (index == 0) ? LFS_CTZ_DEPTH : lfs_offctz(index)+1);
                 }
 
                 *block = nblock;
@@ -2236,7 +3159,7 @@ static int lfs_ctz_extend(lfs_t *lfs,
 
             // append block
             index += 1;
-            lfs_size_t skips = lfs_ctz(index) + 1;
+            lfs_size_t skips = lfs_offctz(index) + 1;
 
             for (lfs_off_t i = 0; i < skips; i++) {
                 head = lfs_tole32(head);
@@ -2251,18 +3174,38 @@ static int lfs_ctz_extend(lfs_t *lfs,
                 }
 
                 if (i != skips-1) {
-                    err = lfs_bd_read(lfs,
-                            NULL, rcache, sizeof(head),
-                            head, 4*i, &head, sizeof(head));
-                    head = lfs_fromle32(head);
-                    if (err) {
-                        return err;
+                    lfs_foff_t prev = index - ((lfs_foff_t)1 << (i+1));
+                    if (prev < first) {
+                        // dropped from the front of the file, these
+                        // pointers are never followed
+                    } else if (i+1 < depth &&
+                            stack[i+1].block != LFS_BLOCK_NULL &&
+                            stack[i+1].index == prev) {
+                        // we wrote this one, no need to read it back
+                        head = stack[i+1].block;
+                    } else {
+                        err = lfs_bd_read(lfs,
+                                NULL, rcache, sizeof(head),
+                                head, 4*i, &head, sizeof(head));
+                        head = lfs_fromle32(head);
+                        if (err) {
+                            return err;
+                        }
+
+                        if (i+1 < depth) {
+                            stack[i+1].index = prev;
+                            stack[i+1].block = head;
+                        }
                     }
                 }
 
                 LFS_ASSERT(head >= 2 && head <= lfs->cfg->block_count);
             }
 
+            if (stack) {
+                lfs_ctz_push(stack, index, nblock, skips);
+            }
+
             *block = nblock;
             *off = 4*skips;
             return 0;
@@ -2278,13 +3221,14 @@ relocate:
 
 static int lfs_ctz_traverse(lfs_t *lfs,
         const lfs_cache_t *pcache, lfs_cache_t *rcache,
-        lfs_block_t head, lfs_size_t size,
+        lfs_block_t head, lfs_foff_t start, lfs_foff_t size,
         int (*cb)(void*, lfs_block_t), void *data) {
     if (size == 0) {
         return 0;
     }
 
-    lfs_off_t index = lfs_ctz_index(lfs, &(lfs_off_t){size-1});
+    lfs_foff_t first = lfs_ctz_first(lfs, start);
+    lfs_foff_t index = lfs_ctz_index(lfs, &(lfs_foff_t){size-1});
 
     while (true) {
         int err = cb(data, head);
@@ -2292,12 +3236,12 @@ static int lfs_ctz_traverse(lfs_t *lfs,
             return err;
         }
 
-        if (index == 0) {
+        if (index <= first) {
             return 0;
         }
 
         lfs_block_t heads[2];
-        int count = 2 - (index & 1);
+        int count = lfs_min(2 - (index & 1), index - first);
         err = lfs_bd_read(lfs,
                 pcache, rcache, count*sizeof(head),
                 head, 0, &heads, count*sizeof(head));
@@ -2321,6 +3265,106 @@ static int lfs_ctz_traverse(lfs_t *lfs,
 
 
 /// Top level file operations ///
+static int lfs_file_loadinline(lfs_t *lfs, lfs_file_t *file) {
+    file->cache.block = LFS_BLOCK_INLINE;
+    file->cache.off = 0;
+    file->cache.size = lfs->cfg->cache_size;
+
+    // don't always read (may be new/trunc file)
+    if (file->ctz.size > 0) {
+        lfs_size_t bsize = lfs_max(lfs->cfg->cache_size, lfs->inline_max);
+        lfs_ssize_t res = lfs_dir_getinline(lfs, &file->m, file->id,
+                file->cache.buffer, bsize);
+        if (res < 0) {
+            return res;
+        }
+
+        // written with a larger inline_max?
+        if ((lfs_size_t)res > bsize) {
+            return LFS_ERR_FBIG;
+        }
+
+        file->ctz.size = res;
+    }
+
+    return 0;
+}
+
+static int lfs_file_getcache(lfs_t *lfs, lfs_file_t *file) {
+    lfs->pool.tick += 1;
+    file->tick = lfs->pool.tick;
+    if (file->cache.buffer) {
+        return 0;
+    }
+
+    // look for a buffer in the pool no file is using
+    uint8_t *buffer = NULL;
+    for (lfs_size_t i = 0; i < lfs->pool.count && !buffer; i++) {
+        buffer = &lfs->pool.buffer[i*lfs->pool.size];
+        for (lfs_file_t *f = (lfs_file_t*)lfs->mlist; f; f = f->next) {
+            if (f->type == LFS_TYPE_REG && f->cache.buffer == buffer) {
+                buffer = NULL;
+                break;
+            }
+        }
+    }
+
+    if (!buffer) {
+        // take the least recently used buffer, preferring files that
+        // aren't writing, since flushing a writer costs progs and may
+        // fail, and never from inline files with changes, which only exist
+        // in their buffer until synced
+        lfs_file_t *victim = NULL;
+        for (lfs_file_t *f = (lfs_file_t*)lfs->mlist; f; f = f->next) {
+            if (f->type != LFS_TYPE_REG || !f->cache.buffer ||
+                    f->cfg->buffer ||
+                    ((f->flags & LFS_F_INLINE) &&
+                        (f->flags & (LFS_F_DIRTY | LFS_F_WRITING)))) {
+                continue;
+            }
+
+            if (!victim) {
+                victim = f;
+            } else if ((f->flags & LFS_F_WRITING) !=
+                    (victim->flags & LFS_F_WRITING)) {
+                if (!(f->flags & LFS_F_WRITING)) {
+                    victim = f;
+                }
+            } else if (lfs_scmp(f->tick, victim->tick) < 0) {
+                victim = f;
+            }
+        }
+
+        if (!victim) {
+            return LFS_ERR_NOMEM;
+        }
+
+        // write out any pending data, the rest of the file's changes
+        // don't need a buffer, note any error here belongs to the victim
+        // but is returned to whoever needed the buffer
+        int err = lfs_file_flush(lfs, victim);
+        if (err) {
+            victim->flags |= LFS_F_ERRED;
+            return err;
+        }
+
+        buffer = victim->cache.buffer;
+        victim->cache.buffer = NULL;
+        lfs_cache_drop(lfs, &victim->cache);
+    }
+
+    // zero to avoid information leak
+    file->cache.buffer = buffer;
+    lfs_cache_zero(lfs, &file->cache);
+
+    if (file->flags & LFS_F_INLINE) {
+        // inline files are held whole in our buffer
+        return lfs_file_loadinline(lfs, file);
+    }
+
+    return 0;
+}
+
 int lfs_file_opencfg(lfs_t *lfs, lfs_file_t *file,
         const char *path, int flags,
         const struct lfs_file_config *cfg) {
@@ -2346,6 +3390,21 @@ int lfs_file_opencfg(lfs_t *lfs, lfs_file_t *file,
     file->off = 0;
     file->cache.buffer = NULL;
 
+    // setup block index, optional
+    LFS_ASSERT((uintptr_t)cfg->index_buffer % 4 == 0);
+    file->index.buffer = cfg->index_buffer;
+    file->index.size = cfg->index_size / sizeof(lfs_block_t);
+    file->index.shift = 0;
+    lfs_ctz_dropindex(&file->index, 0);
+    lfs_ctz_push(lfs_file_stack(file), 0, LFS_BLOCK_NULL, LFS_CTZ_DEPTH);
+
+    // setup block reservation, allocated when first needed
+    LFS_ASSERT((uintptr_t)cfg->reserve_buffer % 4 == 0);
+    file->reserve.buffer = cfg->reserve_buffer;
+    file->reserve.size = cfg->reserve_size / sizeof(lfs_block_t);
+    file->reserve.count = 0;
+    file->reserve.erased = false;
+
     // allocate entry for file if it doesn't exist
     lfs_stag_t tag = lfs_dir_find(lfs, &file->m, &path, &file->id);
     if (tag < 0 && !(tag == LFS_ERR_NOENT && file->id != 0x3ff)) {
@@ -2394,13 +3453,29 @@ int lfs_file_opencfg(lfs_t *lfs, lfs_file_t *file,
         file->flags |= LFS_F_DIRTY;
     } else {
         // try to load what's on disk, if it's inlined we'll fix it later
-        tag = lfs_dir_get(lfs, &file->m, LFS_MKTAG(0x700, 0x3ff, 0),
-                LFS_MKTAG(LFS_TYPE_STRUCT, file->id, 8), &file->ctz);
+        tag = lfs_dir_getctz(lfs, &file->m, file->id, &file->ctz);
         if (tag < 0) {
             err = tag;
             goto cleanup;
         }
-        lfs_ctz_fromle32(&file->ctz);
+    }
+
+    // count journaled appends, older appends may linger after these so
+    // stop once we've found the whole journal
+    file->jcount = 0;
+    if (lfs_tag_isctz(tag)) {
+        for (lfs_size_t j = 0; j < file->ctz.journal; file->jcount++) {
+            lfs_stag_t res = lfs_dir_get(lfs, &file->m,
+                    LFS_MKTAG(0x7ff, 0x3ff, 0),
+                    LFS_MKTAG(LFS_TYPE_JOURNAL + file->jcount, file->id, 0),
+                    NULL);
+            if (res < 0) {
+                err = res;
+                goto cleanup;
+            }
+
+            j += lfs_tag_size(res);
+        }
     }
 
     // fetch attrs
@@ -2427,43 +3502,49 @@ int lfs_file_opencfg(lfs_t *lfs, lfs_file_t *file,
         }
     }
 
-    // allocate buffer if needed
+    // allocate buffer if needed, pooled files borrow one when they need it
     if (file->cfg->buffer) {
         file->cache.buffer = file->cfg->buffer;
-    } else {
-        file->cache.buffer = lfs_malloc(lfs->cfg->cache_size);
+    } else if (!lfs->pool.count) {
+        // big enough to hold an inline file
+        file->cache.buffer = lfs_malloc(
+                lfs_max(lfs->cfg->cache_size, lfs->inline_max));
         if (!file->cache.buffer) {
             err = LFS_ERR_NOMEM;
             goto cleanup;
         }
     }
 
-    // zero to avoid information leak
-    lfs_cache_zero(lfs, &file->cache);
+    if (file->cache.buffer) {
+        // zero to avoid information leak
+        lfs_cache_zero(lfs, &file->cache);
+    } else {
+        lfs_cache_drop(lfs, &file->cache);
+    }
 
     if (lfs_tag_type3(tag) == LFS_TYPE_INLINESTRUCT) {
         // load inline files
         file->ctz.head = LFS_BLOCK_INLINE;
         file->ctz.size = lfs_tag_size(tag);
+        file->ctz.hole = 0;
+        file->ctz.erased = 0;
+        file->ctz.journal = 0;
+        file->ctz.start = 0;
+        file->ctz.pcount = 0;
         file->flags |= LFS_F_INLINE;
-        file->cache.block = file->ctz.head;
-        file->cache.off = 0;
-        file->cache.size = lfs->cfg->cache_size;
 
-        // don't always read (may be new/trunc file)
-        if (file->ctz.size > 0) {
-            lfs_stag_t res = lfs_dir_get(lfs, &file->m,
-                    LFS_MKTAG(0x700, 0x3ff, 0),
-                    LFS_MKTAG(LFS_TYPE_STRUCT, file->id,
-                        lfs_min(file->cache.size, 0x3fe)),
-                    file->cache.buffer);
-            if (res < 0) {
-                err = res;
-                goto cleanup;
-            }
+        // borrowing a buffer loads the file for us
+        err = (file->cache.buffer)
+                ? lfs_file_loadinline(lfs, file)
+                : lfs_file_getcache(lfs, file);
+        if (err) {
+            goto cleanup;
         }
     }
 
+    // data dropped from the front of the file is skipped
+    file->pos = file->ctz.start;
+
     LFS_TRACE("lfs_file_opencfg -> %d", 0);
     return 0;
 
@@ -2499,11 +3580,15 @@ int lfs_file_close(lfs_t *lfs, lfs_file_t *file) {
         }
     }
 
-    // clean up memory
-    if (!file->cfg->buffer) {
+    // clean up memory, pooled buffers are free once we leave the mlist
+    if (!file->cfg->buffer && !lfs->pool.count) {
         lfs_free(file->cache.buffer);
     }
 
+    if (!file->cfg->reserve_buffer) {
+        lfs_free(file->reserve.buffer);
+    }
+
     file->flags &= ~LFS_F_OPENED;
     LFS_TRACE("lfs_file_close -> %d", err);
     return err;
@@ -2515,12 +3600,13 @@ static int lfs_file_relocate(lfs_t *lfs, lfs_file_t *file) {
     while (true) {
         // just relocate what exists into new block
         lfs_block_t nblock;
-        int err = lfs_alloc(lfs, &nblock);
+        bool erased;
+        int err = lfs_ctz_alloc(lfs, &file->reserve, &nblock, &erased);
         if (err) {
             return err;
         }
 
-        err = lfs_bd_erase(lfs, nblock);
+        err = erased ? 0 : lfs_bd_erase(lfs, nblock);
         if (err) {
             if (err == LFS_ERR_CORRUPT) {
                 goto relocate;
@@ -2528,37 +3614,23 @@ static int lfs_file_relocate(lfs_t *lfs, lfs_file_t *file) {
             return err;
         }
 
-        // either read from dirty cache or disk
-        for (lfs_off_t i = 0; i < file->off; i++) {
-            uint8_t data;
-            if (file->flags & LFS_F_INLINE) {
-                err = lfs_dir_getread(lfs, &file->m,
-                        // note we evict inline files before they can be dirty
-                        NULL, &file->cache, file->off-i,
-                        LFS_MKTAG(0xfff, 0x1ff, 0),
-                        LFS_MKTAG(LFS_TYPE_INLINESTRUCT, file->id, 0),
-                        i, &data, 1);
-                if (err) {
-                    return err;
-                }
-            } else {
-                err = lfs_bd_read(lfs,
-                        &file->cache, &lfs->rcache, file->off-i,
-                        file->block, i, &data, 1);
-                if (err) {
-                    return err;
-                }
-            }
-
+        if (file->flags & LFS_F_INLINE) {
+            // inline files always live entirely in our cache
+            LFS_ASSERT(file->cache.block == LFS_BLOCK_INLINE);
             err = lfs_bd_prog(lfs,
                     &lfs->pcache, &lfs->rcache, true,
-                    nblock, i, &data, 1);
-            if (err) {
-                if (err == LFS_ERR_CORRUPT) {
-                    goto relocate;
-                }
-                return err;
+                    nblock, 0, file->cache.buffer, file->off);
+        } else {
+            // either read from dirty cache or disk
+            err = lfs_bd_copy(lfs,
+                    &lfs->pcache, &lfs->rcache, true,
+                    nblock, 0, &file->cache, file->block, 0, file->off);
+        }
+        if (err) {
+            if (err == LFS_ERR_CORRUPT) {
+                goto relocate;
             }
+            return err;
         }
 
         // copy over new state of file
@@ -2568,6 +3640,14 @@ static int lfs_file_relocate(lfs_t *lfs, lfs_file_t *file) {
         file->cache.size = lfs->pcache.size;
         lfs_cache_zero(lfs, &lfs->pcache);
 
+        // remembered ancestors must follow the block, an inline file
+        // becomes the first block of its skip-list
+        if (file->flags & LFS_F_INLINE) {
+            lfs_ctz_push(lfs_file_stack(file), 0, nblock, LFS_CTZ_DEPTH);
+        } else {
+            lfs_ctz_movestack(lfs_file_stack(file), file->block, nblock);
+        }
+
         file->block = nblock;
         file->flags |= LFS_F_WRITING;
         return 0;
@@ -2592,6 +3672,65 @@ static int lfs_file_outline(lfs_t *lfs, lfs_file_t *file) {
     return 0;
 }
 
+static int lfs_file_catchup(lfs_t *lfs, lfs_file_t *file, lfs_foff_t end) {
+    // copy over the original file up to end into the current branch, each
+    // span is read straight into our cache, same as lfs_file_copyctz
+    while (file->pos < end) {
+        // check if we need a new block
+        if (file->off == lfs->cfg->block_size) {
+            lfs_alloc_ack(lfs);
+            int err = lfs_ctz_extend(lfs, &file->cache, &lfs->rcache,
+                    lfs_file_stack(file), &file->reserve,
+                    file->block, file->ctz.start, file->pos,
+                    &file->block, &file->off);
+            if (err) {
+                return err;
+            }
+        }
+
+        // find where this span lives in the original file, our index may
+        // already describe our new branch
+        lfs_block_t sblock;
+        lfs_off_t soff;
+        int err = lfs_ctz_find(lfs, NULL, &lfs->rcache,
+                NULL, file->ctz.head, file->ctz.size,
+                file->pos, &sblock, &soff);
+        if (err) {
+            return err;
+        }
+        sblock = lfs_ctz_patched(lfs, &file->ctz, file->pos, sblock);
+
+        // copy as much as both blocks allow
+        lfs_size_t diff = lfs_offmin(end - file->pos,
+                lfs_min(lfs->cfg->block_size - file->off,
+                    lfs->cfg->block_size - soff));
+        while (true) {
+            err = lfs_bd_copy(lfs,
+                    &file->cache, &lfs->rcache, true,
+                    file->block, file->off, NULL, sblock, soff, diff);
+            if (err) {
+                if (err == LFS_ERR_CORRUPT) {
+                    goto relocate;
+                }
+                return err;
+            }
+
+            break;
+relocate:
+            err = lfs_file_relocate(lfs, file);
+            if (err) {
+                return err;
+            }
+        }
+
+        file->pos += diff;
+        file->off += diff;
+        lfs_alloc_ack(lfs);
+    }
+
+    return 0;
+}
+
 static int lfs_file_flush(lfs_t *lfs, lfs_file_t *file) {
     LFS_ASSERT(file->flags & LFS_F_OPENED);
 
@@ -2603,43 +3742,23 @@ static int lfs_file_flush(lfs_t *lfs, lfs_file_t *file) {
     }
 
     if (file->flags & LFS_F_WRITING) {
-        lfs_off_t pos = file->pos;
+        lfs_foff_t pos = file->pos;
 
         if (!(file->flags & LFS_F_INLINE)) {
-            // copy over anything after current branch
-            lfs_file_t orig = {
-                .ctz.head = file->ctz.head,
-                .ctz.size = file->ctz.size,
-                .flags = LFS_O_RDONLY | LFS_F_OPENED,
-                .pos = file->pos,
-                .cache = lfs->rcache,
-            };
-            lfs_cache_drop(lfs, &lfs->rcache);
-
-            while (file->pos < file->ctz.size) {
-                // copy over a byte at a time, leave it up to caching
-                // to make this efficient
-                uint8_t data;
-                lfs_ssize_t res = lfs_file_read(lfs, &orig, &data, 1);
-                if (res < 0) {
-                    return res;
-                }
-
-                res = lfs_file_write(lfs, file, &data, 1);
-                if (res < 0) {
-                    return res;
-                }
-
-                // keep our reference to the rcache in sync
-                if (lfs->rcache.block != LFS_BLOCK_NULL) {
-                    lfs_cache_drop(lfs, &orig.cache);
-                    lfs_cache_drop(lfs, &lfs->rcache);
-                }
+            // copy over anything after current branch, a patch only needs
+            // the rest of its block
+            int err = lfs_file_catchup(lfs, file,
+                    (file->flags & LFS_F_PATCHING)
+                        ? lfs_offmin(file->ctz.size,
+                            file->pos + (lfs->cfg->block_size - file->off))
+                        : file->ctz.size);
+            if (err) {
+                return err;
             }
 
             // write out what we have
             while (true) {
-                int err = lfs_bd_flush(lfs, &file->cache, &lfs->rcache, true);
+                err = lfs_bd_flush(lfs, &file->cache, &lfs->rcache, true);
                 if (err) {
                     if (err == LFS_ERR_CORRUPT) {
                         goto relocate;
@@ -2657,13 +3776,33 @@ relocate:
                 }
             }
         } else {
-            file->pos = lfs_max(file->pos, file->ctz.size);
-        }
-
-        // actual file updates
-        file->ctz.head = file->block;
-        file->ctz.size = file->pos;
-        file->flags &= ~LFS_F_WRITING;
+            file->pos = lfs_offmax(file->pos, file->ctz.size);
+        }
+
+        // actual file updates, anything we wrote over is no longer a hole
+        lfs_foff_t end = file->ctz.size + file->ctz.hole;
+        if (file->flags & LFS_F_PATCHING) {
+            // only our block was replaced, the skip-list stays as is, but
+            // a patched last block is no longer the erased head
+            lfs_ctz_setpatch(&file->ctz,
+                    lfs_ctz_index(lfs, &(lfs_foff_t){file->pos-1}),
+                    file->block);
+            if (file->pos >= file->ctz.size) {
+                file->ctz.size = file->pos;
+                file->ctz.erased = 0;
+            }
+        } else {
+            file->ctz.head = file->block;
+            file->ctz.size = file->pos;
+            // if we stopped on a prog boundary the rest of our last block
+            // is still erased, appends can keep programming where we left
+            // off
+            file->ctz.erased = (!(file->flags & LFS_F_INLINE) &&
+                    file->off % lfs->cfg->prog_size == 0 &&
+                    file->off < lfs->cfg->block_size) ? file->off : 0;
+        }
+        file->ctz.hole = (end > file->ctz.size) ? end - file->ctz.size : 0;
+        file->flags &= ~(LFS_F_WRITING | LFS_F_PATCHING);
         file->flags |= LFS_F_DIRTY;
 
         file->pos = pos;
@@ -2672,6 +3811,27 @@ relocate:
     return 0;
 }
 
+static void lfs_file_ringdrop(lfs_t *lfs, lfs_file_t *file) {
+    // once a ring file outgrows its ring, drop the oldest data by moving
+    // the start of the file forward, blocks that fall out of the file are
+    // freed when this is committed
+    if (file->cfg->ring_size && !(file->flags & LFS_F_INLINE) &&
+            file->ctz.size - file->ctz.start > file->cfg->ring_size) {
+        file->ctz.start = file->ctz.size - file->cfg->ring_size;
+        lfs_ctz_droppatch(&file->ctz, 0, lfs_ctz_first(lfs, file->ctz.start));
+        file->flags |= LFS_F_DIRTY;
+
+        if (file->pos < file->ctz.start) {
+            // our pos was dropped, continue from the oldest data left
+            if (file->flags & LFS_F_READING) {
+                lfs_cache_drop(lfs, &file->cache);
+                file->flags &= ~LFS_F_READING;
+            }
+            file->pos = file->ctz.start;
+        }
+    }
+}
+
 int lfs_file_sync(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_sync(%p, %p)", (void*)lfs, (void*)file);
     LFS_ASSERT(file->flags & LFS_F_OPENED);
@@ -2684,32 +3844,41 @@ int lfs_file_sync(lfs_t *lfs, lfs_file_t *file) {
             return err;
         }
 
+        lfs_file_ringdrop(lfs, file);
+
         if ((file->flags & LFS_F_DIRTY) &&
                 !(file->flags & LFS_F_ERRED) &&
                 !lfs_pair_isnull(file->m.pair)) {
+            // drop checkpoint if we haven't yet
+            err = lfs_fs_prepwrite(lfs);
+            if (err) {
+                file->flags |= LFS_F_ERRED;
+                LFS_TRACE("lfs_file_sync -> %d", err);
+                return err;
+            }
+
             // update dir entry
-            uint16_t type;
+            lfs_tag_t tag;
             const void *buffer;
-            lfs_size_t size;
-            struct lfs_ctz ctz;
+            uint32_t ctz[LFS_CTZ_WORDS];
             if (file->flags & LFS_F_INLINE) {
-                // inline the whole file
-                type = LFS_TYPE_INLINESTRUCT;
+                // inline the whole file, anything past the first tag is
+                // written out in chunks
+                tag = LFS_MKTAG(LFS_TYPE_INLINESTRUCT, file->id,
+                        lfs_min(file->ctz.size, 0x3fe));
                 buffer = file->cache.buffer;
-                size = file->ctz.size;
             } else {
-                // update the ctz reference
-                type = LFS_TYPE_CTZSTRUCT;
-                // copy ctz so alloc will work during a relocate
-                ctz = file->ctz;
-                lfs_ctz_tole32(&ctz);
-                buffer = &ctz;
-                size = sizeof(ctz);
+                // update the ctz reference, copy ctz so alloc will work
+                // during a relocate
+                tag = lfs_ctz_todisk(&file->ctz, file->id, ctz);
+                buffer = ctz;
             }
 
             // commit file data and attributes
             err = lfs_dir_commit(lfs, &file->m, LFS_MKATTRS(
-                    {LFS_MKTAG(type, file->id, size), buffer},
+                    {tag, buffer},
+                    {LFS_MKTAG(LFS_FROM_INLINE, file->id,
+                        lfs_min(lfs->inline_max / 0x3fe, 0x40)), file},
                     {LFS_MKTAG(LFS_FROM_USERATTRS, file->id,
                         file->cfg->attr_count), file->cfg->attrs}));
             if (err) {
@@ -2738,6 +3907,154 @@ relocate:
     }
 }
 
+static int lfs_file_journalread(lfs_t *lfs, lfs_file_t *file,
+        lfs_off_t off, void *buffer, lfs_size_t size) {
+    // find the journaled appends covering our range, these are stored as
+    // separate tags after the file's data
+    uint8_t *data = buffer;
+    for (uint16_t j = 0; size > 0; j++) {
+        lfs_stag_t tag = lfs_dir_get(lfs, &file->m,
+                LFS_MKTAG(0x7ff, 0x3ff, 0),
+                LFS_MKTAG(LFS_TYPE_JOURNAL + j, file->id, 0), NULL);
+        if (tag < 0) {
+            return tag;
+        }
+
+        if (off >= lfs_tag_size(tag)) {
+            off -= lfs_tag_size(tag);
+            continue;
+        }
+
+        lfs_size_t diff = lfs_min(size, lfs_tag_size(tag) - off);
+        tag = lfs_dir_getslice(lfs, &file->m,
+                LFS_MKTAG(0x7ff, 0x3ff, 0),
+                LFS_MKTAG(LFS_TYPE_JOURNAL + j, file->id, 0),
+                off, data, diff);
+        if (tag < 0) {
+            return tag;
+        }
+
+        off = 0;
+        data += diff;
+        size -= diff;
+    }
+
+    return 0;
+}
+
+static int lfs_file_journal(lfs_t *lfs, lfs_file_t *file,
+        const void *buffer, lfs_size_t size) {
+    // drop checkpoint if we haven't yet
+    int err = lfs_fs_prepwrite(lfs);
+    if (err) {
+        return err;
+    }
+
+    // commit the append as its own tag along with our new size, this
+    // leaves the file's blocks untouched
+    struct lfs_ctz ctz = file->ctz;
+    ctz.journal += size;
+    uint32_t dctz[LFS_CTZ_WORDS];
+    lfs_tag_t ctag = lfs_ctz_todisk(&ctz, file->id, dctz);
+    err = lfs_dir_commit(lfs, &file->m, LFS_MKATTRS(
+            {LFS_MKTAG(LFS_TYPE_JOURNAL + file->jcount, file->id, size),
+                buffer},
+            {ctag, dctz},
+            {LFS_MKTAG(LFS_FROM_USERATTRS, file->id,
+                file->cfg->attr_count), file->cfg->attrs}));
+    if (err) {
+        return err;
+    }
+
+    file->ctz.journal += size;
+    file->jcount += 1;
+    file->pos += size;
+    file->flags &= ~LFS_F_DIRTY;
+    return 0;
+}
+
+static int lfs_file_merge(lfs_t *lfs, lfs_file_t *file) {
+    // write the journal out to the end of the file's blocks, hiding the
+    // journal while we do so, it stays valid on disk until we commit
+    lfs_foff_t pos = file->pos;
+    struct lfs_ctz ctz = file->ctz;
+    file->ctz.journal = 0;
+    file->pos = file->ctz.size;
+    file->flags |= LFS_F_MERGING;
+
+    int err = 0;
+    for (lfs_off_t off = 0; off < ctz.journal;) {
+        uint8_t data[64];
+        lfs_size_t diff = lfs_min(sizeof(data), ctz.journal - off);
+        err = lfs_file_journalread(lfs, file, off, data, diff);
+        if (err) {
+            goto cleanup;
+        }
+
+        lfs_ssize_t res = lfs_file_rawwrite(lfs, file, data, diff);
+        if (res < 0) {
+            err = res;
+            goto cleanup;
+        }
+
+        off += diff;
+    }
+
+    err = lfs_file_flush(lfs, file);
+    if (err) {
+        goto cleanup;
+    }
+
+    if (!lfs_pair_isnull(file->m.pair)) {
+        // drop checkpoint if we haven't yet
+        err = lfs_fs_prepwrite(lfs);
+        if (err) {
+            goto cleanup;
+        }
+
+        // commit our new ctz, deleting the old journal at the same time
+        struct lfs_mattr attrs[LFS_JOURNAL_MAX+2];
+        int attrcount = 0;
+        uint32_t dctz[LFS_CTZ_WORDS];
+        attrs[attrcount++] = (struct lfs_mattr){
+                lfs_ctz_todisk(&file->ctz, file->id, dctz), dctz};
+        for (uint16_t j = 0; j < lfs_min(file->jcount, LFS_JOURNAL_MAX); j++) {
+            attrs[attrcount++] = (struct lfs_mattr){
+                    LFS_MKTAG(LFS_TYPE_JOURNAL + j, file->id, 0x3ff), NULL};
+        }
+        attrs[attrcount++] = (struct lfs_mattr){
+                LFS_MKTAG(LFS_FROM_USERATTRS, file->id,
+                    file->cfg->attr_count), file->cfg->attrs};
+
+        err = lfs_dir_commit(lfs, &file->m, attrs, attrcount);
+        if (err) {
+            goto cleanup;
+        }
+
+        file->flags &= ~LFS_F_DIRTY;
+    }
+
+    file->jcount = 0;
+    file->flags &= ~LFS_F_MERGING;
+    file->pos = pos;
+    return 0;
+
+cleanup:
+    // the journal on disk is still valid, so go back to it, dropping
+    // anything we've written and any ancestors we've remembered from it
+    file->ctz = ctz;
+    file->pos = pos;
+    lfs_cache_drop(lfs, &file->cache);
+    lfs_ctz_dropindex(&file->index, 0);
+    lfs_ctz_dropstack(lfs_file_stack(file), 0);
+    file->flags &= ~(LFS_F_WRITING | LFS_F_MERGING);
+    file->flags |= LFS_F_ERRED;
+    return err;
+}
+
+// zeros handed out when mapping holes
+static const uint8_t lfs_zeros[64] = {0};
+
 lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file,
         void *buffer, lfs_size_t size) {
     LFS_TRACE("lfs_file_read(%p, %p, %p, %"PRIu32")",
@@ -2748,36 +4065,69 @@ lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file,
     uint8_t *data = buffer;
     lfs_size_t nsize = size;
 
+    // borrow a buffer if we don't have one
+    int err = lfs_file_getcache(lfs, file);
+    if (err) {
+        LFS_TRACE("lfs_file_read -> %d", err);
+        return err;
+    }
+
     if (file->flags & LFS_F_WRITING) {
         // flush out any writes
-        int err = lfs_file_flush(lfs, file);
+        err = lfs_file_flush(lfs, file);
         if (err) {
             LFS_TRACE("lfs_file_read -> %d", err);
             return err;
         }
     }
 
-    if (file->pos >= file->ctz.size) {
+    lfs_foff_t end = file->ctz.size + file->ctz.hole + file->ctz.journal;
+    if (file->pos >= end) {
         // eof if past end
         LFS_TRACE("lfs_file_read -> %d", 0);
         return 0;
     }
 
-    size = lfs_min(size, file->ctz.size - file->pos);
+    size = lfs_offmin(size, end - file->pos);
     nsize = size;
 
     while (nsize > 0) {
+        if (file->pos >= file->ctz.size) {
+            // past the data is either the journal or a hole, neither of
+            // which live in the file's blocks
+            if (file->flags & LFS_F_READING) {
+                lfs_cache_drop(lfs, &file->cache);
+                file->flags &= ~LFS_F_READING;
+            }
+
+            if (file->ctz.journal > 0) {
+                err = lfs_file_journalread(lfs, file,
+                        file->pos - file->ctz.size, data, nsize);
+                if (err) {
+                    LFS_TRACE("lfs_file_read -> %d", err);
+                    return err;
+                }
+            } else {
+                memset(data, 0, nsize);
+            }
+
+            file->pos += nsize;
+            break;
+        }
+
         // check if we need a new block
         if (!(file->flags & LFS_F_READING) ||
                 file->off == lfs->cfg->block_size) {
             if (!(file->flags & LFS_F_INLINE)) {
-                int err = lfs_ctz_find(lfs, NULL, &file->cache,
-                        file->ctz.head, file->ctz.size,
+                err = lfs_ctz_find(lfs, NULL, &file->cache,
+                        &file->index, file->ctz.head, file->ctz.size,
                         file->pos, &file->block, &file->off);
                 if (err) {
                     LFS_TRACE("lfs_file_read -> %d", err);
                     return err;
                 }
+                file->block = lfs_ctz_patched(lfs, &file->ctz,
+                        file->pos, file->block);
             } else {
                 file->block = LFS_BLOCK_INLINE;
                 file->off = file->pos;
@@ -2788,18 +4138,12 @@ lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file,
 
         // read as much as we can in current block
         lfs_size_t diff = lfs_min(nsize, lfs->cfg->block_size - file->off);
+        diff = lfs_offmin(diff, file->ctz.size - file->pos);
         if (file->flags & LFS_F_INLINE) {
-            int err = lfs_dir_getread(lfs, &file->m,
-                    NULL, &file->cache, lfs->cfg->block_size,
-                    LFS_MKTAG(0xfff, 0x1ff, 0),
-                    LFS_MKTAG(LFS_TYPE_INLINESTRUCT, file->id, 0),
-                    file->off, data, diff);
-            if (err) {
-                LFS_TRACE("lfs_file_read -> %d", err);
-                return err;
-            }
+            // inline files are held whole in our buffer
+            memcpy(data, &file->cache.buffer[file->off], diff);
         } else {
-            int err = lfs_bd_read(lfs,
+            err = lfs_bd_read(lfs,
                     NULL, &file->cache, lfs->cfg->block_size,
                     file->block, file->off, data, diff);
             if (err) {
@@ -2818,92 +4162,326 @@ lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file,
     return size;
 }
 
-lfs_ssize_t lfs_file_write(lfs_t *lfs, lfs_file_t *file,
-        const void *buffer, lfs_size_t size) {
-    LFS_TRACE("lfs_file_write(%p, %p, %p, %"PRIu32")",
-            (void*)lfs, (void*)file, buffer, size);
+lfs_ssize_t lfs_file_map(lfs_t *lfs, lfs_file_t *file,
+        lfs_foff_t off, const void **buffer) {
+    LFS_TRACE("lfs_file_map(%p, %p, %"LFS_PRIuFOFF", %p)",
+            (void*)lfs, (void*)file, off, (void*)buffer);
     LFS_ASSERT(file->flags & LFS_F_OPENED);
-    LFS_ASSERT((file->flags & 3) != LFS_O_RDONLY);
-
-    const uint8_t *data = buffer;
-    lfs_size_t nsize = size;
+    LFS_ASSERT((file->flags & 3) != LFS_O_WRONLY);
 
-    if (file->flags & LFS_F_READING) {
-        // drop any reads
+    if (file->flags & LFS_F_WRITING) {
+        // flush out any writes
         int err = lfs_file_flush(lfs, file);
         if (err) {
-            LFS_TRACE("lfs_file_write -> %d", err);
+            LFS_TRACE("lfs_file_map -> %d", err);
             return err;
         }
     }
 
-    if ((file->flags & LFS_O_APPEND) && file->pos < file->ctz.size) {
-        file->pos = file->ctz.size;
-    }
-
-    if (file->pos + size > lfs->file_max) {
-        // Larger than file limit?
-        LFS_TRACE("lfs_file_write -> %d", LFS_ERR_FBIG);
-        return LFS_ERR_FBIG;
+    // skip any data dropped from the front of the file
+    off += file->ctz.start;
+    lfs_foff_t end = file->ctz.size + file->ctz.hole + file->ctz.journal;
+    if (off >= end) {
+        // eof if past end
+        LFS_TRACE("lfs_file_map -> %d", 0);
+        return 0;
     }
 
-    if (!(file->flags & LFS_F_WRITING) && file->pos > file->ctz.size) {
-        // fill with zeros
-        lfs_off_t pos = file->pos;
-        file->pos = file->ctz.size;
+    lfs_size_t size;
+    if (off >= file->ctz.size && file->ctz.journal > 0) {
+        // journaled appends are spread through the metadata log
+        LFS_TRACE("lfs_file_map -> %d", LFS_ERR_INVAL);
+        return LFS_ERR_INVAL;
+    } else if (off >= file->ctz.size) {
+        // holes are all zeros
+        *buffer = lfs_zeros;
+        size = lfs_offmin(sizeof(lfs_zeros), end - off);
+    } else if (file->flags & LFS_F_INLINE) {
+        // inline files are held whole in our buffer
+        int err = lfs_file_getcache(lfs, file);
+        if (err) {
+            LFS_TRACE("lfs_file_map -> %d", err);
+            return err;
+        }
 
-        while (file->pos < pos) {
-            lfs_ssize_t res = lfs_file_write(lfs, file, &(uint8_t){0}, 1);
-            if (res < 0) {
-                LFS_TRACE("lfs_file_write -> %"PRId32, res);
-                return res;
-            }
+        *buffer = &file->cache.buffer[off];
+        size = file->ctz.size - off;
+    } else {
+        if (!lfs->cfg->map) {
+            LFS_TRACE("lfs_file_map -> %d", LFS_ERR_INVAL);
+            return LFS_ERR_INVAL;
         }
-    }
 
-    if ((file->flags & LFS_F_INLINE) &&
-            lfs_max(file->pos+nsize, file->ctz.size) >
-            lfs_min(0x3fe, lfs_min(
-                lfs->cfg->cache_size, lfs->cfg->block_size/8))) {
-        // inline file doesn't fit anymore
-        int err = lfs_file_outline(lfs, file);
+        // find the block, leaving our file's cache alone
+        lfs_block_t block;
+        lfs_off_t boff;
+        int err = lfs_ctz_find(lfs, NULL, &lfs->rcache,
+                &file->index, file->ctz.head, file->ctz.size,
+                off, &block, &boff);
         if (err) {
-            file->flags |= LFS_F_ERRED;
-            LFS_TRACE("lfs_file_write -> %d", err);
+            LFS_TRACE("lfs_file_map -> %d", err);
             return err;
         }
+        block = lfs_ctz_patched(lfs, &file->ctz, off, block);
+
+        *buffer = lfs->cfg->map(lfs->cfg, block, boff);
+        if (!*buffer) {
+            LFS_TRACE("lfs_file_map -> %d", LFS_ERR_INVAL);
+            return LFS_ERR_INVAL;
+        }
+
+        // data is contiguous up to the end of the block
+        size = lfs_offmin(lfs->cfg->block_size - boff, file->ctz.size - off);
     }
 
-    while (nsize > 0) {
-        // check if we need a new block
-        if (!(file->flags & LFS_F_WRITING) ||
-                file->off == lfs->cfg->block_size) {
-            if (!(file->flags & LFS_F_INLINE)) {
-                if (!(file->flags & LFS_F_WRITING) && file->pos > 0) {
-                    // find out which block we're extending from
-                    int err = lfs_ctz_find(lfs, NULL, &file->cache,
-                            file->ctz.head, file->ctz.size,
-                            file->pos-1, &file->block, &file->off);
-                    if (err) {
-                        file->flags |= LFS_F_ERRED;
-                        LFS_TRACE("lfs_file_write -> %d", err);
-                        return err;
-                    }
+    LFS_TRACE("lfs_file_map -> %"PRId32, size);
+    return size;
+}
 
-                    // mark cache as dirty since we may have read data into it
-                    lfs_cache_zero(lfs, &file->cache);
-                }
+static int lfs_file_unerase(lfs_t *lfs, lfs_file_t *file) {
+    // before programming in place, our entry on disk must stop claiming
+    // any block is erased, otherwise losing power mid-program leaves a
+    // partially programmed block that later appends would program over,
+    // the next sync records where the erased part now starts
+    if (lfs_pair_isnull(file->m.pair)) {
+        return 0;
+    }
 
-                // extend file with new blocks
-                lfs_alloc_ack(lfs);
-                int err = lfs_ctz_extend(lfs, &file->cache, &lfs->rcache,
-                        file->block, file->pos,
-                        &file->block, &file->off);
-                if (err) {
-                    file->flags |= LFS_F_ERRED;
-                    LFS_TRACE("lfs_file_write -> %d", err);
-                    return err;
-                }
+    struct lfs_ctz ctz;
+    lfs_stag_t tag = lfs_dir_getctz(lfs, &file->m, file->id, &ctz);
+    if (tag < 0) {
+        return tag;
+    }
+
+    if (!lfs_tag_isctz(tag) || ctz.erased == 0) {
+        return 0;
+    }
+
+    int err = lfs_fs_prepwrite(lfs);
+    if (err) {
+        return err;
+    }
+
+    ctz.erased = 0;
+    uint32_t dctz[LFS_CTZ_WORDS];
+    return lfs_dir_commit(lfs, &file->m, LFS_MKATTRS(
+            {lfs_ctz_todisk(&ctz, file->id, dctz), dctz}));
+}
+
+static int lfs_file_branch(lfs_t *lfs, lfs_file_t *file) {
+    // start a new branch of the skip-list at our pos, or extend the branch
+    // we are already writing
+    bool inplace = false;
+    lfs_foff_t i = (file->pos > 0)
+            ? lfs_ctz_index(lfs, &(lfs_foff_t){file->pos-1})
+            : 0;
+    if (!(file->flags & LFS_F_WRITING) && file->pos > 0) {
+        // find out which block we're extending from, a patched block
+        // stands in for the original
+        int err = lfs_ctz_find(lfs, NULL, &file->cache,
+                &file->index, file->ctz.head, file->ctz.size,
+                file->pos-1, &file->block, &file->off);
+        if (err) {
+            return err;
+        }
+        file->block = lfs_ctz_patched(lfs, &file->ctz,
+                file->pos-1, file->block);
+
+        // mark cache as dirty since we may have read data into it
+        lfs_cache_zero(lfs, &file->cache);
+
+        // appending to a last block that is still erased?
+        inplace = (file->pos == file->ctz.size &&
+                file->block == file->ctz.head &&
+                file->off+1 == file->ctz.erased);
+        if (inplace) {
+            err = lfs_file_unerase(lfs, file);
+            if (err) {
+                return err;
+            }
+        }
+    }
+
+    if (!(file->flags & LFS_F_WRITING)) {
+        // blocks from here on are about to be rewritten
+        lfs_ctz_dropindex(&file->index, i);
+        lfs_ctz_dropstack(lfs_file_stack(file), i);
+
+        if (inplace) {
+            // program right after our data, if this fails
+            // validation we relocate like any other bad block
+            lfs_ctz_push(lfs_file_stack(file), i, file->block,
+                    (i == 0) ? LFS_CTZ_DEPTH : lfs_offctz(i)+1);
+            file->off += 1;
+        }
+    }
+
+    if (!inplace) {
+        // extend file with new blocks
+        lfs_alloc_ack(lfs);
+        int err = lfs_ctz_extend(lfs, &file->cache, &lfs->rcache,
+                lfs_file_stack(file), &file->reserve,
+                file->block, file->ctz.start, file->pos,
+                &file->block, &file->off);
+        if (err) {
+            return err;
+        }
+    }
+
+    if (!(file->flags & LFS_F_WRITING) && file->pos >= file->ctz.size) {
+        // appending, our last block was either copied into the branch or
+        // is now pointed to directly, so its patch is no longer needed
+        lfs_ctz_droppatch(&file->ctz, i, (lfs_foff_t)-1);
+    }
+
+    file->flags |= LFS_F_WRITING;
+    return 0;
+}
+
+static int lfs_file_patch(lfs_t *lfs, lfs_file_t *file) {
+    // writing inside the file? instead of rewriting everything after our
+    // write, copy only the block we're writing to and record the copy in
+    // the file's patch table, the skip-list itself is left alone
+    const struct lfs_ctzpatch *patch = LFS_CTZ_PATCH(&file->ctz);
+    lfs_foff_t i = lfs_ctz_index(lfs, &(lfs_foff_t){file->pos});
+    bool patched = false;
+    lfs_foff_t last = 0;
+    for (lfs_size_t j = 0; j < file->ctz.pcount; j++) {
+        patched = patched || patch[j].index == i;
+        last = lfs_offmax(last, patch[j].index);
+    }
+
+    if (!patched && file->ctz.pcount >= lfs->patch_max) {
+        if (i > last) {
+            // no room for another patch, but every patch is before us, so
+            // branching from our block is the cheapest thing to do
+            return 0;
+        }
+
+        // no room for another patch, write the last patch back into the
+        // skip-list, this rewrites every block after it, but no other
+        // patch is cheaper to drop
+        lfs_foff_t pos = file->pos;
+        lfs_foff_t b = lfs->cfg->block_size - 2*4;
+        file->pos = (last > 0)
+                ? b*last + 4*lfs_offpopc(last) + 4*(lfs_offctz(last)+1)
+                : 0;
+        int err = lfs_file_branch(lfs, file);
+        if (!err) {
+            err = lfs_file_flush(lfs, file);
+        }
+        file->pos = pos;
+        if (err) {
+            return err;
+        }
+
+        lfs_ctz_droppatch(&file->ctz, last, last+1);
+    }
+
+    // find the block we're replacing
+    lfs_block_t block;
+    lfs_off_t off;
+    int err = lfs_ctz_find(lfs, NULL, &file->cache,
+            &file->index, file->ctz.head, file->ctz.size,
+            file->pos, &block, &off);
+    if (err) {
+        return err;
+    }
+    block = lfs_ctz_patched(lfs, &file->ctz, file->pos, block);
+
+    // mark cache as dirty since we may have read data into it
+    lfs_cache_zero(lfs, &file->cache);
+
+    lfs_alloc_ack(lfs);
+    while (true) {
+        lfs_block_t nblock;
+        bool erased;
+        err = lfs_ctz_alloc(lfs, &file->reserve, &nblock, &erased);
+        if (err) {
+            return err;
+        }
+
+        err = erased ? 0 : lfs_bd_erase(lfs, nblock);
+        if (err) {
+            if (err == LFS_ERR_CORRUPT) {
+                goto relocate;
+            }
+            return err;
+        }
+
+        // copy everything before our write, including the skip-list
+        // pointers, so the patch can stand in for the original block
+        err = lfs_bd_copy(lfs,
+                &file->cache, &lfs->rcache, true,
+                nblock, 0, NULL, block, 0, off);
+        if (err) {
+            if (err == LFS_ERR_CORRUPT) {
+                goto relocate;
+            }
+            return err;
+        }
+
+        file->block = nblock;
+        file->off = off;
+        file->flags |= LFS_F_WRITING | LFS_F_PATCHING;
+        return 0;
+
+relocate:
+        LFS_DEBUG("Bad block at %"PRIx32, nblock);
+
+        // just clear cache and try a new block
+        lfs_cache_drop(lfs, &file->cache);
+    }
+}
+
+// write to the file at its pos, a NULL buffer writes zeros, which lets us
+// fill in files without going through the public write path
+static lfs_ssize_t lfs_file_rawwrite(lfs_t *lfs, lfs_file_t *file,
+        const void *buffer, lfs_size_t size) {
+    const uint8_t *data = buffer;
+    lfs_size_t nsize = size;
+    int err;
+
+    if ((file->flags & LFS_F_INLINE) &&
+            lfs_offmax(file->pos+nsize, file->ctz.size) > lfs->inline_max) {
+        // inline file doesn't fit anymore
+        err = lfs_file_outline(lfs, file);
+        if (err) {
+            file->flags |= LFS_F_ERRED;
+            return err;
+        }
+    }
+
+    while (nsize > 0) {
+        // check if we need a new block
+        if (!(file->flags & LFS_F_WRITING) ||
+                file->off == lfs->cfg->block_size) {
+            if (!(file->flags & LFS_F_INLINE)) {
+                if (file->flags & LFS_F_PATCHING) {
+                    // finished a patch, record it before moving on
+                    err = lfs_file_flush(lfs, file);
+                    if (err) {
+                        file->flags |= LFS_F_ERRED;
+                        return err;
+                    }
+                }
+
+                if (!(file->flags & LFS_F_WRITING) &&
+                        file->pos < file->ctz.size && lfs->patch_max > 0) {
+                    err = lfs_file_patch(lfs, file);
+                    if (err) {
+                        file->flags |= LFS_F_ERRED;
+                        return err;
+                    }
+                }
+
+                if (!(file->flags & LFS_F_PATCHING)) {
+                    err = lfs_file_branch(lfs, file);
+                    if (err) {
+                        file->flags |= LFS_F_ERRED;
+                        return err;
+                    }
+                }
             } else {
                 file->block = LFS_BLOCK_INLINE;
                 file->off = file->pos;
@@ -2914,78 +4492,243 @@ lfs_ssize_t lfs_file_write(lfs_t *lfs, lfs_file_t *file,
 
         // program as much as we can in current block
         lfs_size_t diff = lfs_min(nsize, lfs->cfg->block_size - file->off);
-        while (true) {
-            int err = lfs_bd_prog(lfs, &file->cache, &lfs->rcache, true,
-                    file->block, file->off, data, diff);
-            if (err) {
-                if (err == LFS_ERR_CORRUPT) {
-                    goto relocate;
-                }
-                file->flags |= LFS_F_ERRED;
-                LFS_TRACE("lfs_file_write -> %d", err);
-                return err;
+        if (file->flags & LFS_F_INLINE) {
+            // inline files are held whole in our buffer
+            if (data) {
+                memcpy(&file->cache.buffer[file->off], data, diff);
+            } else {
+                memset(&file->cache.buffer[file->off], 0, diff);
             }
+        } else {
+            while (true) {
+                err = lfs_bd_prog(lfs,
+                        &file->cache, &lfs->rcache, true,
+                        file->block, file->off, data, diff);
+                if (err) {
+                    if (err == LFS_ERR_CORRUPT) {
+                        goto relocate;
+                    }
+                    file->flags |= LFS_F_ERRED;
+                    return err;
+                }
 
-            break;
+                break;
 relocate:
-            err = lfs_file_relocate(lfs, file);
-            if (err) {
-                file->flags |= LFS_F_ERRED;
-                LFS_TRACE("lfs_file_write -> %d", err);
-                return err;
+                err = lfs_file_relocate(lfs, file);
+                if (err) {
+                    file->flags |= LFS_F_ERRED;
+                    return err;
+                }
             }
         }
 
         file->pos += diff;
         file->off += diff;
-        data += diff;
+        data += (data) ? diff : 0;
         nsize -= diff;
 
         lfs_alloc_ack(lfs);
     }
 
     file->flags &= ~LFS_F_ERRED;
-    LFS_TRACE("lfs_file_write -> %"PRId32, size);
     return size;
 }
 
-lfs_soff_t lfs_file_seek(lfs_t *lfs, lfs_file_t *file,
-        lfs_soff_t off, int whence) {
-    LFS_TRACE("lfs_file_seek(%p, %p, %"PRId32", %d)",
-            (void*)lfs, (void*)file, off, whence);
+lfs_ssize_t lfs_file_write(lfs_t *lfs, lfs_file_t *file,
+        const void *buffer, lfs_size_t size) {
+    LFS_TRACE("lfs_file_write(%p, %p, %p, %"PRIu32")",
+            (void*)lfs, (void*)file, buffer, size);
     LFS_ASSERT(file->flags & LFS_F_OPENED);
+    LFS_ASSERT((file->flags & 3) != LFS_O_RDONLY);
 
-    // write out everything beforehand, may be noop if rdonly
-    int err = lfs_file_flush(lfs, file);
+    if (file->flags & LFS_F_READING) {
+        // drop any reads
+        int err = lfs_file_flush(lfs, file);
+        if (err) {
+            LFS_TRACE("lfs_file_write -> %d", err);
+            return err;
+        }
+    }
+
+    lfs_foff_t end = file->ctz.size + file->ctz.hole + file->ctz.journal;
+    if ((file->flags & LFS_O_APPEND) && file->pos < end) {
+        file->pos = end;
+    }
+
+    if (file->pos - file->ctz.start + size > lfs->file_max ||
+            file->pos + size < file->pos) {
+        // Larger than file limit? Data dropped from the front of a ring
+        // file doesn't count, but our pos still has to fit in an offset
+        LFS_TRACE("lfs_file_write -> %d", LFS_ERR_FBIG);
+        return LFS_ERR_FBIG;
+    }
+
+    if (file->cfg->journal_size &&
+            !(file->flags & (LFS_F_WRITING | LFS_F_INLINE | LFS_F_MERGING)) &&
+            file->pos == end && file->ctz.hole == 0 &&
+            size > 0 && size <= 0x3fe &&
+            file->ctz.journal + size <= lfs_min(
+                file->cfg->journal_size, lfs->cfg->block_size/8) &&
+            file->jcount < LFS_JOURNAL_MAX &&
+            !lfs_pair_isnull(file->m.pair)) {
+        // small append that fits in the journal? commit it with the
+        // metadata and leave the file's blocks alone
+        int err = lfs_file_journal(lfs, file, buffer, size);
+        if (err) {
+            file->flags |= LFS_F_ERRED;
+            LFS_TRACE("lfs_file_write -> %d", err);
+            return err;
+        }
+
+        file->flags &= ~LFS_F_ERRED;
+        LFS_TRACE("lfs_file_write -> %"PRId32, size);
+        return size;
+    }
+
+    // borrow a buffer if we don't have one
+    int err = lfs_file_getcache(lfs, file);
     if (err) {
-        LFS_TRACE("lfs_file_seek -> %d", err);
+        LFS_TRACE("lfs_file_write -> %d", err);
         return err;
     }
 
-    // find new pos
-    lfs_off_t npos = file->pos;
+    if (file->ctz.journal > 0) {
+        // journal is full or we're writing elsewhere, move the journal
+        // into the file's blocks first
+        err = lfs_file_merge(lfs, file);
+        if (err) {
+            LFS_TRACE("lfs_file_write -> %d", err);
+            return err;
+        }
+    }
+
+    if (!(file->flags & LFS_F_WRITING) && file->pos > file->ctz.size) {
+        // fill with zeros, these are programmed a cache at a time
+        lfs_foff_t pos = file->pos;
+        file->pos = file->ctz.size;
+        while (file->pos < pos) {
+            lfs_ssize_t res = lfs_file_rawwrite(lfs, file, NULL,
+                    lfs_offmin(lfs->cfg->block_size, pos - file->pos));
+            if (res < 0) {
+                LFS_TRACE("lfs_file_write -> %"PRId32, res);
+                return res;
+            }
+        }
+    }
+
+    lfs_ssize_t res = lfs_file_rawwrite(lfs, file, buffer, size);
+    LFS_TRACE("lfs_file_write -> %"PRId32, res);
+    return res;
+}
+
+lfs_sfoff_t lfs_file_seek(lfs_t *lfs, lfs_file_t *file,
+        lfs_sfoff_t off, int whence) {
+    LFS_TRACE("lfs_file_seek(%p, %p, %"LFS_PRIdFOFF", %d)",
+            (void*)lfs, (void*)file, off, whence);
+    LFS_ASSERT(file->flags & LFS_F_OPENED);
+
+    // find new pos, our pos counts any data dropped from the front of the
+    // file, but that is hidden from the user
+    lfs_foff_t npos = file->pos;
     if (whence == LFS_SEEK_SET) {
-        npos = off;
+        npos = file->ctz.start + off;
     } else if (whence == LFS_SEEK_CUR) {
         npos = file->pos + off;
     } else if (whence == LFS_SEEK_END) {
-        npos = file->ctz.size + off;
+        npos = file->ctz.start + lfs_file_size(lfs, file) + off;
     }
 
-    if (npos > lfs->file_max) {
+    if (npos < file->ctz.start || npos - file->ctz.start > lfs->file_max) {
         // file position out of range
         LFS_TRACE("lfs_file_seek -> %d", LFS_ERR_INVAL);
         return LFS_ERR_INVAL;
     }
 
+    if ((file->flags & LFS_F_WRITING) && !(file->flags & LFS_F_INLINE) &&
+            npos >= file->pos && npos <= file->ctz.size &&
+            (!(file->flags & LFS_F_PATCHING) ||
+                npos - file->pos <= lfs->cfg->block_size - file->off)) {
+        // seeking forward while writing, the blocks after our write need
+        // to be rewritten anyways, so only copy up to the new pos and keep
+        // writing, flushing here would copy the rest of the file only for
+        // the next write to rewrite it again, patches can only do this
+        // inside their block
+        int err = lfs_file_catchup(lfs, file, npos);
+        if (err) {
+            LFS_TRACE("lfs_file_seek -> %d", err);
+            return err;
+        }
+
+        LFS_TRACE("lfs_file_seek -> %"LFS_PRIdFOFF, npos - file->ctz.start);
+        return npos - file->ctz.start;
+    }
+
+    // write out everything beforehand, reads may get to keep their cache
+    if (file->flags & LFS_F_WRITING) {
+        int err = lfs_file_flush(lfs, file);
+        if (err) {
+            LFS_TRACE("lfs_file_seek -> %d", err);
+            return err;
+        }
+    }
+
+    if ((file->flags & LFS_F_READING) && npos < file->ctz.size) {
+        if (file->flags & LFS_F_INLINE) {
+            // inline files are a single block
+            file->off = npos;
+            file->pos = npos;
+            LFS_TRACE("lfs_file_seek -> %"LFS_PRIdFOFF, npos - file->ctz.start);
+            return npos - file->ctz.start;
+        }
+
+        // find the block we are currently reading
+        lfs_foff_t csize = (file->off == lfs->cfg->block_size)
+                ? file->pos
+                : file->pos+1;
+        lfs_foff_t cindex = lfs_ctz_index(lfs, &(lfs_foff_t){csize-1});
+        lfs_foff_t noff = npos;
+        lfs_foff_t nindex = lfs_ctz_index(lfs, &noff);
+
+        if (nindex == cindex) {
+            // same block, keep our cache
+            file->off = noff;
+            file->pos = npos;
+            LFS_TRACE("lfs_file_seek -> %"LFS_PRIdFOFF, npos - file->ctz.start);
+            return npos - file->ctz.start;
+        } else if (nindex < cindex) {
+            // earlier block, the skip-list lets us start from our current
+            // block instead of the end of the file
+            int err = lfs_ctz_find(lfs, NULL, &file->cache,
+                    &file->index, file->block, csize,
+                    npos, &file->block, &file->off);
+            if (err) {
+                LFS_TRACE("lfs_file_seek -> %d", err);
+                return err;
+            }
+            file->block = lfs_ctz_patched(lfs, &file->ctz,
+                    npos, file->block);
+
+            file->pos = npos;
+            LFS_TRACE("lfs_file_seek -> %"LFS_PRIdFOFF, npos - file->ctz.start);
+            return npos - file->ctz.start;
+        }
+    }
+
+    // drop any read state, may be noop
+    int err = lfs_file_flush(lfs, file);
+    if (err) {
+        LFS_TRACE("lfs_file_seek -> %d", err);
+        return err;
+    }
+
     // update pos
     file->pos = npos;
-    LFS_TRACE("lfs_file_seek -> %"PRId32, npos);
-    return npos;
+    LFS_TRACE("lfs_file_seek -> %"LFS_PRIdFOFF, npos - file->ctz.start);
+    return npos - file->ctz.start;
 }
 
-int lfs_file_truncate(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
-    LFS_TRACE("lfs_file_truncate(%p, %p, %"PRIu32")",
+int lfs_file_truncate(lfs_t *lfs, lfs_file_t *file, lfs_foff_t size) {
+    LFS_TRACE("lfs_file_truncate(%p, %p, %"LFS_PRIuFOFF")",
             (void*)lfs, (void*)file, size);
     LFS_ASSERT(file->flags & LFS_F_OPENED);
     LFS_ASSERT((file->flags & 3) != LFS_O_RDONLY);
@@ -2995,52 +4738,120 @@ int lfs_file_truncate(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
         return LFS_ERR_INVAL;
     }
 
-    lfs_off_t pos = file->pos;
-    lfs_off_t oldsize = lfs_file_size(lfs, file);
-    if (size < oldsize) {
-        // need to flush since directly changing metadata
-        int err = lfs_file_flush(lfs, file);
+    // borrow a buffer if we don't have one
+    int err = lfs_file_getcache(lfs, file);
+    if (err) {
+        LFS_TRACE("lfs_file_truncate -> %d", err);
+        return err;
+    }
+
+    if (file->ctz.journal > 0) {
+        // simpler to resize without a journal
+        err = lfs_file_merge(lfs, file);
         if (err) {
             LFS_TRACE("lfs_file_truncate -> %d", err);
             return err;
         }
+    }
 
-        // lookup new head in ctz skip list
-        err = lfs_ctz_find(lfs, NULL, &file->cache,
-                file->ctz.head, file->ctz.size,
-                size, &file->block, &file->off);
+    // work in terms of our pos, which counts any data dropped from the
+    // front of the file
+    size += file->ctz.start;
+    lfs_foff_t pos = file->pos;
+    lfs_foff_t oldsize = file->ctz.start + lfs_file_size(lfs, file);
+    if (size < oldsize) {
+        // need to flush since directly changing metadata
+        err = lfs_file_flush(lfs, file);
         if (err) {
             LFS_TRACE("lfs_file_truncate -> %d", err);
             return err;
         }
 
-        file->ctz.head = file->block;
-        file->ctz.size = size;
-        file->flags |= LFS_F_DIRTY | LFS_F_READING;
+        if (size >= file->ctz.size) {
+            // only cutting into the hole, no data changes
+            file->ctz.hole = size - file->ctz.size;
+            file->flags |= LFS_F_DIRTY;
+        } else {
+            // lookup new head in ctz skip list
+            err = lfs_ctz_find(lfs, NULL, &file->cache,
+                    &file->index, file->ctz.head, file->ctz.size,
+                    size, &file->block, &file->off);
+            if (err) {
+                LFS_TRACE("lfs_file_truncate -> %d", err);
+                return err;
+            }
+
+            // our cache may hold data past the new end
+            if (!(file->flags & LFS_F_INLINE)) {
+                lfs_cache_drop(lfs, &file->cache);
+            }
+
+            file->ctz.head = file->block;
+            file->ctz.size = size;
+            file->ctz.hole = 0;
+            file->ctz.erased = 0;
+            // patches past our new end are no longer part of the file
+            lfs_ctz_droppatch(&file->ctz,
+                    (size > 0)
+                        ? lfs_ctz_index(lfs, &(lfs_foff_t){size-1})+1
+                        : 0,
+                    (lfs_foff_t)-1);
+            file->flags |= LFS_F_DIRTY;
+        }
     } else if (size > oldsize) {
         // flush+seek if not already at end
         if (file->pos != oldsize) {
-            lfs_soff_t res = lfs_file_seek(lfs, file, 0, LFS_SEEK_END);
+            lfs_sfoff_t res = lfs_file_seek(lfs, file, 0, LFS_SEEK_END);
             if (res < 0) {
-                LFS_TRACE("lfs_file_truncate -> %"PRId32, res);
+                LFS_TRACE("lfs_file_truncate -> %"LFS_PRIdFOFF, res);
                 return (int)res;
             }
         }
 
-        // fill with zeros
-        while (file->pos < size) {
-            lfs_ssize_t res = lfs_file_write(lfs, file, &(uint8_t){0}, 1);
+        if (file->flags & LFS_F_READING) {
+            // drop any reads
+            err = lfs_file_flush(lfs, file);
+            if (err) {
+                LFS_TRACE("lfs_file_truncate -> %d", err);
+                return err;
+            }
+        }
+
+        // fill inline files with zeros if they still fit, otherwise
+        // outline them and leave the rest as a hole
+        if ((file->flags & LFS_F_INLINE) && size <= lfs->inline_max) {
+            lfs_ssize_t res = lfs_file_rawwrite(lfs, file,
+                    NULL, size - file->pos);
             if (res < 0) {
                 LFS_TRACE("lfs_file_truncate -> %"PRId32, res);
                 return (int)res;
             }
+        } else if (file->flags & LFS_F_INLINE) {
+            err = lfs_file_outline(lfs, file);
+            if (err) {
+                file->flags |= LFS_F_ERRED;
+                LFS_TRACE("lfs_file_truncate -> %d", err);
+                return err;
+            }
+        }
+
+        if (file->pos < size) {
+            err = lfs_file_flush(lfs, file);
+            if (err) {
+                LFS_TRACE("lfs_file_truncate -> %d", err);
+                return err;
+            }
+
+            file->ctz.hole = size - file->ctz.size;
+            file->flags |= LFS_F_DIRTY;
         }
     }
 
     // restore pos
-    lfs_soff_t res = lfs_file_seek(lfs, file, pos, LFS_SEEK_SET);
+    lfs_sfoff_t res = lfs_file_seek(lfs, file,
+            pos - file->ctz.start, LFS_SEEK_SET);
     if (res < 0) {
-      LFS_TRACE("lfs_file_truncate -> %"PRId32, res);
+      LFS_TRACE("lfs_file_truncate -> %"LFS_PRIdFOFF, res);
       return (int)res;
     }
 
@@ -3048,19 +4859,126 @@ int lfs_file_truncate(lfs_t *lfs, lfs_file_t *file, lfs_off_t size) {
     return 0;
 }
 
-lfs_soff_t lfs_file_tell(lfs_t *lfs, lfs_file_t *file) {
+int lfs_file_reserve(lfs_t *lfs, lfs_file_t *file,
+        lfs_foff_t size, bool erase) {
+    LFS_TRACE("lfs_file_reserve(%p, %p, %"LFS_PRIuFOFF", %d)",
+            (void*)lfs, (void*)file, size, erase);
+    LFS_ASSERT(file->flags & LFS_F_OPENED);
+    LFS_ASSERT((file->flags & 3) != LFS_O_RDONLY);
+
+    if (size > lfs->file_max) {
+        LFS_TRACE("lfs_file_reserve -> %d", LFS_ERR_INVAL);
+        return LFS_ERR_INVAL;
+    }
+
+    // find how many blocks the file already has, anything past this needs
+    // new blocks, plus one for copying the last block if we aren't
+    // already writing to it
+    size += file->ctz.start;
+    lfs_foff_t cur = (file->flags & LFS_F_INLINE) ? 0
+            : (file->flags & LFS_F_WRITING)
+                ? lfs_offmax(file->pos, file->ctz.size)
+            : file->ctz.size;
+    if (size <= cur) {
+        LFS_TRACE("lfs_file_reserve -> %d", 0);
+        return 0;
+    }
+
+    lfs_size_t count = lfs_ctz_index(lfs, &(lfs_foff_t){size-1}) + 1;
+    if (cur > 0) {
+        count -= lfs_ctz_index(lfs, &(lfs_foff_t){cur-1}) + 1;
+        count += (file->flags & LFS_F_WRITING) ? 0 : 1;
+    }
+
+    // mixing erased and unerased blocks isn't worth tracking
+    erase = erase || (file->reserve.count > 0 && file->reserve.erased);
+    if (erase && !file->reserve.erased) {
+        for (lfs_size_t i = 0; i < file->reserve.count; i++) {
+            int err = lfs_bd_erase(lfs, file->reserve.buffer[i]);
+            if (err) {
+                LFS_TRACE("lfs_file_reserve -> %d", err);
+                return err;
+            }
+        }
+        file->reserve.erased = true;
+    }
+
+    if (count <= file->reserve.count) {
+        LFS_TRACE("lfs_file_reserve -> %d", 0);
+        return 0;
+    }
+
+    // make room to track the reservation
+    if (count > file->reserve.size) {
+        if (file->cfg->reserve_buffer) {
+            LFS_TRACE("lfs_file_reserve -> %d", LFS_ERR_NOMEM);
+            return LFS_ERR_NOMEM;
+        }
+
+        lfs_block_t *buffer = lfs_malloc(count*sizeof(lfs_block_t));
+        if (!buffer) {
+            LFS_TRACE("lfs_file_reserve -> %d", LFS_ERR_NOMEM);
+            return LFS_ERR_NOMEM;
+        }
+
+        if (file->reserve.count > 0) {
+            memcpy(buffer, file->reserve.buffer,
+                    file->reserve.count*sizeof(lfs_block_t));
+        }
+        lfs_free(file->reserve.buffer);
+        file->reserve.buffer = buffer;
+        file->reserve.size = count;
+    }
+
+    // reserved blocks show up in lfs_fs_traverse as soon as they are
+    // added, so the allocator can't hand them out again
+    lfs_size_t oldcount = file->reserve.count;
+    lfs_alloc_ack(lfs);
+    while (file->reserve.count < count) {
+        lfs_block_t block;
+        int err = lfs_alloc(lfs, &block);
+        if (err) {
+            file->reserve.count = oldcount;
+            LFS_TRACE("lfs_file_reserve -> %d", err);
+            return err;
+        }
+
+        if (erase) {
+            err = lfs_bd_erase(lfs, block);
+            if (err) {
+                if (err == LFS_ERR_CORRUPT) {
+                    // skip bad blocks
+                    LFS_DEBUG("Bad block at %"PRIx32, block);
+                    continue;
+                }
+                file->reserve.count = oldcount;
+                LFS_TRACE("lfs_file_reserve -> %d", err);
+                return err;
+            }
+        }
+
+        file->reserve.buffer[file->reserve.count] = block;
+        file->reserve.count += 1;
+    }
+
+    file->reserve.erased = erase;
+    LFS_TRACE("lfs_file_reserve -> %d", 0);
+    return 0;
+}
+
+lfs_sfoff_t lfs_file_tell(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_tell(%p, %p)", (void*)lfs, (void*)file);
     LFS_ASSERT(file->flags & LFS_F_OPENED);
     (void)lfs;
-    LFS_TRACE("lfs_file_tell -> %"PRId32, file->pos);
-    return file->pos;
+    LFS_TRACE("lfs_file_tell -> %"LFS_PRIdFOFF, file->pos - file->ctz.start);
+    return file->pos - file->ctz.start;
 }
 
 int lfs_file_rewind(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_rewind(%p, %p)", (void*)lfs, (void*)file);
-    lfs_soff_t res = lfs_file_seek(lfs, file, 0, LFS_SEEK_SET);
+    lfs_sfoff_t res = lfs_file_seek(lfs, file, 0, LFS_SEEK_SET);
     if (res < 0) {
-        LFS_TRACE("lfs_file_rewind -> %"PRId32, res);
+        LFS_TRACE("lfs_file_rewind -> %"LFS_PRIdFOFF, res);
         return (int)res;
     }
 
@@ -3068,18 +4986,17 @@ int lfs_file_rewind(lfs_t *lfs, lfs_file_t *file) {
     return 0;
 }
 
-lfs_soff_t lfs_file_size(lfs_t *lfs, lfs_file_t *file) {
+lfs_sfoff_t lfs_file_size(lfs_t *lfs, lfs_file_t *file) {
     LFS_TRACE("lfs_file_size(%p, %p)", (void*)lfs, (void*)file);
     LFS_ASSERT(file->flags & LFS_F_OPENED);
     (void)lfs;
+    lfs_foff_t size = file->ctz.size + file->ctz.hole + file->ctz.journal;
     if (file->flags & LFS_F_WRITING) {
-        LFS_TRACE("lfs_file_size -> %"PRId32,
-                lfs_max(file->pos, file->ctz.size));
-        return lfs_max(file->pos, file->ctz.size);
-    } else {
-        LFS_TRACE("lfs_file_size -> %"PRId32, file->ctz.size);
-        return file->ctz.size;
+        size = lfs_offmax(file->pos, size);
     }
+
+    LFS_TRACE("lfs_file_size -> %"LFS_PRIdFOFF, size - file->ctz.start);
+    return size - file->ctz.start;
 }
 
 
@@ -3246,51 +5163,276 @@ int lfs_rename(lfs_t *lfs, const char *oldpath, const char *newpath) {
         newoldtagid += 1;
     }
 
-    lfs_fs_prepmove(lfs, newoldtagid, oldcwd.pair);
-
-    // move over all attributes
-    err = lfs_dir_commit(lfs, &newcwd, LFS_MKATTRS(
-            {prevtag != LFS_ERR_NOENT
-                ? LFS_MKTAG(LFS_TYPE_DELETE, newid, 0)
-                : LFS_MKTAG(LFS_FROM_NOOP, 0, 0), NULL},
-            {LFS_MKTAG(LFS_TYPE_CREATE, newid, 0), NULL},
-            {LFS_MKTAG(lfs_tag_type3(oldtag), newid, strlen(newpath)),
-                newpath},
-            {LFS_MKTAG(LFS_FROM_MOVE, newid, lfs_tag_id(oldtag)), &oldcwd}));
+    lfs_fs_prepmove(lfs, newoldtagid, oldcwd.pair);
+
+    // move over all attributes
+    err = lfs_dir_commit(lfs, &newcwd, LFS_MKATTRS(
+            {prevtag != LFS_ERR_NOENT
+                ? LFS_MKTAG(LFS_TYPE_DELETE, newid, 0)
+                : LFS_MKTAG(LFS_FROM_NOOP, 0, 0), NULL},
+            {LFS_MKTAG(LFS_TYPE_CREATE, newid, 0), NULL},
+            {LFS_MKTAG(lfs_tag_type3(oldtag), newid, strlen(newpath)),
+                newpath},
+            {LFS_MKTAG(LFS_FROM_MOVE, newid, lfs_tag_id(oldtag)), &oldcwd}));
+    if (err) {
+        LFS_TRACE("lfs_rename -> %d", err);
+        return err;
+    }
+
+    // let commit clean up after move (if we're different! otherwise move
+    // logic already fixed it for us)
+    if (lfs_pair_cmp(oldcwd.pair, newcwd.pair) != 0) {
+        err = lfs_dir_commit(lfs, &oldcwd, NULL, 0);
+        if (err) {
+            LFS_TRACE("lfs_rename -> %d", err);
+            return err;
+        }
+    }
+
+    if (prevtag != LFS_ERR_NOENT && lfs_tag_type3(prevtag) == LFS_TYPE_DIR) {
+        // fix orphan
+        lfs_fs_preporphans(lfs, -1);
+
+        err = lfs_fs_pred(lfs, prevdir.pair, &newcwd);
+        if (err) {
+            LFS_TRACE("lfs_rename -> %d", err);
+            return err;
+        }
+
+        err = lfs_dir_drop(lfs, &newcwd, &prevdir);
+        if (err) {
+            LFS_TRACE("lfs_rename -> %d", err);
+            return err;
+        }
+    }
+
+    LFS_TRACE("lfs_rename -> %d", 0);
+    return 0;
+}
+
+int lfs_file_clone(lfs_t *lfs, const char *srcpath, const char *dstpath) {
+    LFS_TRACE("lfs_file_clone(%p, \"%s\", \"%s\")",
+            (void*)lfs, srcpath, dstpath);
+
+    // deorphan if we haven't yet, needed at most once after poweron
+    int err = lfs_fs_forceconsistency(lfs);
+    if (err) {
+        LFS_TRACE("lfs_file_clone -> %d", err);
+        return err;
+    }
+
+    // find source entry, only files can be cloned
+    lfs_mdir_t srccwd;
+    lfs_stag_t srctag = lfs_dir_find(lfs, &srccwd, &srcpath, NULL);
+    if (srctag < 0 || lfs_tag_id(srctag) == 0x3ff) {
+        LFS_TRACE("lfs_file_clone -> %"PRId32,
+                (srctag < 0) ? srctag : LFS_ERR_ISDIR);
+        return (srctag < 0) ? (int)srctag : LFS_ERR_ISDIR;
+    }
+
+    if (lfs_tag_type3(srctag) != LFS_TYPE_REG) {
+        LFS_TRACE("lfs_file_clone -> %d", LFS_ERR_ISDIR);
+        return LFS_ERR_ISDIR;
+    }
+
+    // find destination entry, must not exist yet
+    lfs_mdir_t dstcwd;
+    uint16_t dstid;
+    lfs_stag_t dsttag = lfs_dir_find(lfs, &dstcwd, &dstpath, &dstid);
+    if (dsttag >= 0) {
+        LFS_TRACE("lfs_file_clone -> %d", LFS_ERR_EXIST);
+        return LFS_ERR_EXIST;
+    } else if (dsttag != LFS_ERR_NOENT || dstid == 0x3ff) {
+        LFS_TRACE("lfs_file_clone -> %"PRId32, dsttag);
+        return (int)dsttag;
+    }
+
+    // check that name fits
+    lfs_size_t nlen = strlen(dstpath);
+    if (nlen > lfs->name_max) {
+        LFS_TRACE("lfs_file_clone -> %d", LFS_ERR_NAMETOOLONG);
+        return LFS_ERR_NAMETOOLONG;
+    }
+
+    // ctz lists are never modified once written, so both entries can point
+    // at the same blocks, block allocation already finds blocks by
+    // traversing every entry, so shared blocks stay in use until the last
+    // entry referencing them is gone
+    //
+    // the one exception is the erased tail of the last block, only the
+    // source may keep appending in place
+    struct lfs_ctz ctz;
+    lfs_stag_t tag = lfs_dir_getctz(lfs, &srccwd, lfs_tag_id(srctag), &ctz);
+    if (tag < 0) {
+        LFS_TRACE("lfs_file_clone -> %"PRId32, tag);
+        return (int)tag;
+    }
+
+    bool shared = (lfs_tag_isctz(tag) && ctz.erased);
+    ctz.erased = 0;
+    uint32_t dctz[LFS_CTZ_WORDS];
+    lfs_tag_t ctag = lfs_ctz_todisk(&ctz, dstid, dctz);
+
+    // copy over all attributes and file data kept in the metadata log
+    err = lfs_dir_commit(lfs, &dstcwd, LFS_MKATTRS(
+            {LFS_MKTAG(LFS_TYPE_CREATE, dstid, 0), NULL},
+            {LFS_MKTAG(LFS_TYPE_REG, dstid, nlen), dstpath},
+            {LFS_MKTAG(LFS_FROM_MOVE, dstid, lfs_tag_id(srctag)), &srccwd},
+            {shared ? ctag : LFS_MKTAG(LFS_FROM_NOOP, 0, 0), dctz}));
+    if (err) {
+        LFS_TRACE("lfs_file_clone -> %d", err);
+        return err;
+    }
+
+    LFS_TRACE("lfs_file_clone -> %d", 0);
+    return 0;
+}
+
+static int lfs_file_copyctz(lfs_t *lfs, lfs_file_t *file, lfs_file_t *src) {
+    // build our skip-list directly, copying each source block straight
+    // into our cache without passing through a buffer
+    int err = lfs_file_getcache(lfs, file);
+    if (err) {
+        return err;
+    }
+
+    file->flags &= ~LFS_F_INLINE;
+    lfs_cache_zero(lfs, &file->cache);
+
+    while (file->pos < src->ctz.size - src->ctz.start) {
+        // check if we need a new block
+        if (!(file->flags & LFS_F_WRITING) ||
+                file->off == lfs->cfg->block_size) {
+            lfs_alloc_ack(lfs);
+            err = lfs_ctz_extend(lfs, &file->cache, &lfs->rcache,
+                    lfs_file_stack(file), &file->reserve,
+                    file->block, 0, file->pos,
+                    &file->block, &file->off);
+            if (err) {
+                return err;
+            }
+
+            file->flags |= LFS_F_WRITING;
+        }
+
+        // find where this span lives in the source, the source may not
+        // have a buffer of its own
+        lfs_block_t sblock;
+        lfs_off_t soff;
+        err = lfs_ctz_find(lfs, NULL, &lfs->rcache,
+                &src->index, src->ctz.head, src->ctz.size,
+                src->ctz.start + file->pos, &sblock, &soff);
+        if (err) {
+            return err;
+        }
+        sblock = lfs_ctz_patched(lfs, &src->ctz,
+                src->ctz.start + file->pos, sblock);
+
+        // copy as much as both blocks allow
+        lfs_size_t diff = lfs_offmin(
+                src->ctz.size - src->ctz.start - file->pos,
+                lfs_min(lfs->cfg->block_size - file->off,
+                    lfs->cfg->block_size - soff));
+        while (true) {
+            err = lfs_bd_copy(lfs,
+                    &file->cache, &lfs->rcache, true,
+                    file->block, file->off, NULL, sblock, soff, diff);
+            if (err) {
+                if (err == LFS_ERR_CORRUPT) {
+                    goto relocate;
+                }
+                return err;
+            }
+
+            break;
+relocate:
+            err = lfs_file_relocate(lfs, file);
+            if (err) {
+                return err;
+            }
+        }
+
+        file->pos += diff;
+        file->off += diff;
+    }
+
+    return 0;
+}
+
+int lfs_copy(lfs_t *lfs, const char *srcpath, const char *dstpath) {
+    LFS_TRACE("lfs_copy(%p, \"%s\", \"%s\")", (void*)lfs, srcpath, dstpath);
+    lfs_file_t src;
+    int err = lfs_file_open(lfs, &src, srcpath, LFS_O_RDONLY);
+    if (err) {
+        LFS_TRACE("lfs_copy -> %d", err);
+        return err;
+    }
+
+    lfs_file_t dst;
+    err = lfs_file_open(lfs, &dst, dstpath,
+            LFS_O_WRONLY | LFS_O_CREAT | LFS_O_EXCL);
     if (err) {
-        LFS_TRACE("lfs_rename -> %d", err);
+        lfs_file_close(lfs, &src);
+        LFS_TRACE("lfs_copy -> %d", err);
         return err;
     }
 
-    // let commit clean up after move (if we're different! otherwise move
-    // logic already fixed it for us)
-    if (lfs_pair_cmp(oldcwd.pair, newcwd.pair) != 0) {
-        err = lfs_dir_commit(lfs, &oldcwd, NULL, 0);
+    if (!(src.flags & LFS_F_INLINE) && src.ctz.size > src.ctz.start) {
+        err = lfs_file_copyctz(lfs, &dst, &src);
         if (err) {
-            LFS_TRACE("lfs_rename -> %d", err);
-            return err;
+            goto cleanup;
+        }
+
+        lfs_sfoff_t res = lfs_file_seek(lfs, &src,
+                src.ctz.size - src.ctz.start, LFS_SEEK_SET);
+        if (res < 0) {
+            err = res;
+            goto cleanup;
         }
     }
 
-    if (prevtag != LFS_ERR_NOENT && lfs_tag_type3(prevtag) == LFS_TYPE_DIR) {
-        // fix orphan
-        lfs_fs_preporphans(lfs, -1);
+    // inline files and journaled appends are small, these can go through
+    // a buffer, our files may not both have their own buffer at once
+    while (src.pos < src.ctz.size + src.ctz.journal) {
+        uint8_t data[64];
+        lfs_ssize_t res = lfs_file_read(lfs, &src, data,
+                lfs_offmin(sizeof(data),
+                    src.ctz.size + src.ctz.journal - src.pos));
+        if (res < 0) {
+            err = res;
+            goto cleanup;
+        }
 
-        err = lfs_fs_pred(lfs, prevdir.pair, &newcwd);
-        if (err) {
-            LFS_TRACE("lfs_rename -> %d", err);
-            return err;
+        res = lfs_file_write(lfs, &dst, data, res);
+        if (res < 0) {
+            err = res;
+            goto cleanup;
         }
+    }
 
-        err = lfs_dir_drop(lfs, &newcwd, &prevdir);
+    // holes stay holes
+    if (lfs_file_size(lfs, &dst) < lfs_file_size(lfs, &src)) {
+        err = lfs_file_truncate(lfs, &dst, lfs_file_size(lfs, &src));
         if (err) {
-            LFS_TRACE("lfs_rename -> %d", err);
-            return err;
+            goto cleanup;
         }
     }
 
-    LFS_TRACE("lfs_rename -> %d", 0);
-    return 0;
+cleanup:
+    if (err) {
+        // don't leave a partial copy behind
+        dst.flags |= LFS_F_ERRED;
+        lfs_file_close(lfs, &dst);
+        lfs_file_close(lfs, &src);
+        lfs_remove(lfs, dstpath);
+        LFS_TRACE("lfs_copy -> %d", err);
+        return err;
+    }
+
+    err = lfs_file_close(lfs, &dst);
+    lfs_file_close(lfs, &src);
+    LFS_TRACE("lfs_copy -> %d", err);
+    return err;
 }
 
 lfs_ssize_t lfs_getattr(lfs_t *lfs, const char *path,
@@ -3336,6 +5478,12 @@ lfs_ssize_t lfs_getattr(lfs_t *lfs, const char *path,
 
 static int lfs_commitattr(lfs_t *lfs, const char *path,
         uint8_t type, const void *buffer, lfs_size_t size) {
+    // drop checkpoint if we haven't yet
+    int err = lfs_fs_prepwrite(lfs);
+    if (err) {
+        return err;
+    }
+
     lfs_mdir_t cwd;
     lfs_stag_t tag = lfs_dir_find(lfs, &cwd, &path, NULL);
     if (tag < 0) {
@@ -3346,7 +5494,7 @@ static int lfs_commitattr(lfs_t *lfs, const char *path,
     if (id == 0x3ff) {
         // special case for root
         id = 0;
-        int err = lfs_dir_fetch(lfs, &cwd, lfs->root);
+        err = lfs_dir_fetch(lfs, &cwd, lfs->root);
         if (err) {
             return err;
         }
@@ -3378,6 +5526,255 @@ int lfs_removeattr(lfs_t *lfs, const char *path, uint8_t type) {
 }
 
 
+/// Batch operations ///
+int lfs_batch_begin(lfs_t *lfs, lfs_batch_t *batch) {
+    LFS_TRACE("lfs_batch_begin(%p, %p)", (void*)lfs, (void*)batch);
+    // deorphan if we haven't yet, needed at most once after poweron
+    int err = lfs_fs_forceconsistency(lfs);
+    if (err) {
+        LFS_TRACE("lfs_batch_begin -> %d", err);
+        return err;
+    }
+
+    // the pair is decided by the first operation
+    batch->m.pair[0] = LFS_BLOCK_NULL;
+    batch->m.pair[1] = LFS_BLOCK_NULL;
+    batch->attrcount = 0;
+    LFS_TRACE("lfs_batch_begin -> %d", 0);
+    return 0;
+}
+
+static int lfs_batch_replay(const lfs_batch_t *batch,
+        lfs_size_t i, uint16_t *id) {
+    // replay creates and deletes in the batch, starting at attr i
+    for (; i < batch->attrcount; i++) {
+        lfs_tag_t tag = batch->attrs[i].tag;
+        if (lfs_tag_type3(tag) == LFS_TYPE_DELETE &&
+                *id == lfs_tag_id(tag)) {
+            return LFS_ERR_NOENT;
+        } else if (lfs_tag_type3(tag) == LFS_TYPE_DELETE &&
+                *id > lfs_tag_id(tag)) {
+            *id -= 1;
+        } else if (lfs_tag_type3(tag) == LFS_TYPE_CREATE &&
+                *id >= lfs_tag_id(tag)) {
+            *id += 1;
+        }
+    }
+
+    return 0;
+}
+
+static lfs_stag_t lfs_batch_find(lfs_t *lfs, lfs_batch_t *batch,
+        const char **path, uint16_t *id) {
+    // find entry as it will be once the batch is committed
+    lfs_mdir_t cwd;
+    lfs_stag_t tag = lfs_dir_find(lfs, &cwd, path, id);
+    if (tag < 0 && !(tag == LFS_ERR_NOENT && *id != 0x3ff)) {
+        return tag;
+    }
+
+    if (tag >= 0 && lfs_tag_id(tag) == 0x3ff) {
+        // special case for root
+        int err = lfs_dir_fetch(lfs, &cwd, lfs->root);
+        if (err) {
+            return err;
+        }
+    }
+
+    // everything in a batch must end up in one commit
+    if (lfs_pair_isnull(batch->m.pair)) {
+        batch->m = cwd;
+    } else if (lfs_pair_cmp(cwd.pair, batch->m.pair) != 0) {
+        return LFS_ERR_INVAL;
+    }
+
+    if (tag >= 0 && lfs_tag_id(tag) == 0x3ff) {
+        *id = 0x3ff;
+        return tag;
+    }
+
+    // entries created in the batch shadow anything on disk
+    lfs_size_t nlen = strlen(*path);
+    for (lfs_size_t i = batch->attrcount; i >= 2; i--) {
+        const struct lfs_mattr *create = &batch->attrs[i-2];
+        const struct lfs_mattr *name = &batch->attrs[i-1];
+        if (lfs_tag_type3(create->tag) == LFS_TYPE_CREATE &&
+                lfs_tag_size(name->tag) == nlen &&
+                memcmp(name->buffer, *path, nlen) == 0) {
+            *id = lfs_tag_id(create->tag);
+            if (lfs_batch_replay(batch, i, id) == 0) {
+                return LFS_MKTAG(lfs_tag_type3(name->tag), *id, 0);
+            }
+            break;
+        }
+    }
+
+    uint16_t pos = (tag >= 0) ? lfs_tag_id(tag) : *id;
+    if (tag >= 0) {
+        *id = lfs_tag_id(tag);
+        if (lfs_batch_replay(batch, 0, id) == 0) {
+            return LFS_MKTAG(lfs_tag_type3(tag), *id, lfs_tag_size(tag));
+        }
+    }
+
+    // not found, entries are kept sorted by name, so find where we would
+    // be inserted once the batch's creates and deletes are applied
+    for (lfs_size_t i = 0; i < batch->attrcount; i++) {
+        lfs_tag_t splice = batch->attrs[i].tag;
+        if (lfs_tag_type3(splice) == LFS_TYPE_DELETE &&
+                lfs_tag_id(splice) < pos) {
+            pos -= 1;
+        } else if (lfs_tag_type3(splice) == LFS_TYPE_CREATE &&
+                lfs_tag_id(splice) <= pos) {
+            // same comparison as lfs_dir_find_match
+            const struct lfs_mattr *name = &batch->attrs[i+1];
+            lfs_size_t diff = lfs_min(nlen, lfs_tag_size(name->tag));
+            int res = memcmp(name->buffer, *path, diff);
+            if (lfs_tag_id(splice) < pos || res < 0 ||
+                    (res == 0 && nlen < lfs_tag_size(name->tag))) {
+                pos += 1;
+            }
+        }
+    }
+
+    *id = pos;
+    return LFS_ERR_NOENT;
+}
+
+int lfs_batch_create(lfs_t *lfs, lfs_batch_t *batch, const char *path,
+        const void *buffer, lfs_size_t size) {
+    LFS_TRACE("lfs_batch_create(%p, %p, \"%s\", %p, %"PRIu32")",
+            (void*)lfs, (void*)batch, path, buffer, size);
+    if (batch->attrcount + 3 > LFS_BATCH_MAX) {
+        LFS_TRACE("lfs_batch_create -> %d", LFS_ERR_NOMEM);
+        return LFS_ERR_NOMEM;
+    }
+
+    // batched files are always inlined in a single tag
+    if (size > lfs_min(0x3fe, lfs->inline_max)) {
+        LFS_TRACE("lfs_batch_create -> %d", LFS_ERR_FBIG);
+        return LFS_ERR_FBIG;
+    }
+
+    uint16_t id;
+    lfs_stag_t tag = lfs_batch_find(lfs, batch, &path, &id);
+    if (!(tag == LFS_ERR_NOENT && id != 0x3ff)) {
+        LFS_TRACE("lfs_batch_create -> %d", (tag < 0) ? tag : LFS_ERR_EXIST);
+        return (tag < 0) ? tag : LFS_ERR_EXIST;
+    }
+
+    // check that name fits
+    lfs_size_t nlen = strlen(path);
+    if (nlen > lfs->name_max) {
+        LFS_TRACE("lfs_batch_create -> %d", LFS_ERR_NAMETOOLONG);
+        return LFS_ERR_NAMETOOLONG;
+    }
+
+    struct lfs_mattr *attrs = &batch->attrs[batch->attrcount];
+    attrs[0] = (struct lfs_mattr){LFS_MKTAG(LFS_TYPE_CREATE, id, 0), NULL};
+    attrs[1] = (struct lfs_mattr){LFS_MKTAG(LFS_TYPE_REG, id, nlen), path};
+    attrs[2] = (struct lfs_mattr){
+            LFS_MKTAG(LFS_TYPE_INLINESTRUCT, id, size), buffer};
+    batch->attrcount += 3;
+    LFS_TRACE("lfs_batch_create -> %d", 0);
+    return 0;
+}
+
+static int lfs_batch_commitattr(lfs_t *lfs, lfs_batch_t *batch,
+        const char *path, uint8_t type, const void *buffer, lfs_size_t size) {
+    if (batch->attrcount + 1 > LFS_BATCH_MAX) {
+        return LFS_ERR_NOMEM;
+    }
+
+    uint16_t id;
+    lfs_stag_t tag = lfs_batch_find(lfs, batch, &path, &id);
+    if (tag < 0) {
+        return tag;
+    }
+
+    if (id == 0x3ff) {
+        // special case for root
+        id = 0;
+    }
+
+    batch->attrs[batch->attrcount] = (struct lfs_mattr){
+            LFS_MKTAG(LFS_TYPE_USERATTR + type, id, size), buffer};
+    batch->attrcount += 1;
+    return 0;
+}
+
+int lfs_batch_setattr(lfs_t *lfs, lfs_batch_t *batch, const char *path,
+        uint8_t type, const void *buffer, lfs_size_t size) {
+    LFS_TRACE("lfs_batch_setattr(%p, %p, \"%s\", %"PRIu8", %p, %"PRIu32")",
+            (void*)lfs, (void*)batch, path, type, buffer, size);
+    if (size > lfs->attr_max) {
+        LFS_TRACE("lfs_batch_setattr -> %d", LFS_ERR_NOSPC);
+        return LFS_ERR_NOSPC;
+    }
+
+    int err = lfs_batch_commitattr(lfs, batch, path, type, buffer, size);
+    LFS_TRACE("lfs_batch_setattr -> %d", err);
+    return err;
+}
+
+int lfs_batch_removeattr(lfs_t *lfs, lfs_batch_t *batch, const char *path,
+        uint8_t type) {
+    LFS_TRACE("lfs_batch_removeattr(%p, %p, \"%s\", %"PRIu8")",
+            (void*)lfs, (void*)batch, path, type);
+    int err = lfs_batch_commitattr(lfs, batch, path, type, NULL, 0x3ff);
+    LFS_TRACE("lfs_batch_removeattr -> %d", err);
+    return err;
+}
+
+int lfs_batch_remove(lfs_t *lfs, lfs_batch_t *batch, const char *path) {
+    LFS_TRACE("lfs_batch_remove(%p, %p, \"%s\")",
+            (void*)lfs, (void*)batch, path);
+    if (batch->attrcount + 1 > LFS_BATCH_MAX) {
+        LFS_TRACE("lfs_batch_remove -> %d", LFS_ERR_NOMEM);
+        return LFS_ERR_NOMEM;
+    }
+
+    uint16_t id;
+    lfs_stag_t tag = lfs_batch_find(lfs, batch, &path, &id);
+    if (tag < 0 || id == 0x3ff) {
+        LFS_TRACE("lfs_batch_remove -> %d", (tag < 0) ? tag : LFS_ERR_INVAL);
+        return (tag < 0) ? tag : LFS_ERR_INVAL;
+    }
+
+    // directories live in the tail list, which we can't update atomically
+    if (lfs_tag_type3(tag) == LFS_TYPE_DIR) {
+        LFS_TRACE("lfs_batch_remove -> %d", LFS_ERR_ISDIR);
+        return LFS_ERR_ISDIR;
+    }
+
+    batch->attrs[batch->attrcount] = (struct lfs_mattr){
+            LFS_MKTAG(LFS_TYPE_DELETE, id, 0), NULL};
+    batch->attrcount += 1;
+    LFS_TRACE("lfs_batch_remove -> %d", 0);
+    return 0;
+}
+
+int lfs_batch_commit(lfs_t *lfs, lfs_batch_t *batch) {
+    LFS_TRACE("lfs_batch_commit(%p, %p)", (void*)lfs, (void*)batch);
+    if (batch->attrcount == 0) {
+        // nothing to do
+        LFS_TRACE("lfs_batch_commit -> %d", 0);
+        return 0;
+    }
+
+    int err = lfs_dir_commit(lfs, &batch->m,
+            batch->attrs, batch->attrcount);
+    if (err) {
+        LFS_TRACE("lfs_batch_commit -> %d", err);
+        return err;
+    }
+
+    batch->attrcount = 0;
+    LFS_TRACE("lfs_batch_commit -> %d", 0);
+    return 0;
+}
+
+
 /// Filesystem operations ///
 static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
     lfs->cfg = cfg;
@@ -3396,7 +5793,7 @@ static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
     LFS_ASSERT(lfs->cfg->block_size % lfs->cfg->cache_size == 0);
 
     // check that the block size is large enough to fit ctz pointers
-    LFS_ASSERT(4*lfs_npw2(LFS_BLOCK_NULL / (lfs->cfg->block_size-2*4))
+    LFS_ASSERT(4*lfs_offnpw2((lfs_foff_t)-1 / (lfs->cfg->block_size-2*4))
             <= lfs->cfg->block_size);
 
     // block_cycles = 0 is no longer supported.
@@ -3448,6 +5845,23 @@ static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
         }
     }
 
+    // setup directory index, optional
+    LFS_ASSERT((uintptr_t)lfs->cfg->index_buffer % 4 == 0);
+    lfs->index.size = lfs->cfg->index_size / sizeof(lfs_index_entry_t);
+    lfs->index.off = 0;
+    lfs->index.buffer = NULL;
+    if (lfs->index.size) {
+        if (lfs->cfg->index_buffer) {
+            lfs->index.buffer = lfs->cfg->index_buffer;
+        } else {
+            lfs->index.buffer = lfs_malloc(lfs->cfg->index_size);
+            if (!lfs->index.buffer) {
+                err = LFS_ERR_NOMEM;
+                goto cleanup;
+            }
+        }
+    }
+
     // check that the size limits are sane
     LFS_ASSERT(lfs->cfg->name_max <= LFS_NAME_MAX);
     lfs->name_max = lfs->cfg->name_max;
@@ -3467,7 +5881,42 @@ static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
         lfs->attr_max = LFS_ATTR_MAX;
     }
 
+    LFS_ASSERT(lfs->cfg->patch_max <= LFS_PATCH_MAX);
+    lfs->patch_max = lfs->cfg->patch_max;
+    if (!lfs->patch_max) {
+        lfs->patch_max = LFS_PATCH_MAX;
+    }
+
+    // inline files need to fit in a metadata block with room to spare, and
+    // can span at most 0x41 tags
+    LFS_ASSERT(lfs->cfg->inline_max <= lfs->cfg->block_size/2);
+    LFS_ASSERT(lfs->cfg->inline_max <= 0x41*0x3fe);
+    lfs->inline_max = lfs->cfg->inline_max;
+    if (!lfs->inline_max) {
+        lfs->inline_max = lfs_min(0x3fe, lfs_min(
+                lfs->cfg->cache_size, lfs->cfg->block_size/8));
+    }
+
+    // setup file buffer pool, optional, each buffer must be able to hold
+    // an inline file
+    lfs->pool.count = lfs->cfg->pool_count;
+    lfs->pool.size = lfs_max(lfs->cfg->cache_size, lfs->inline_max);
+    lfs->pool.tick = 0;
+    lfs->pool.buffer = NULL;
+    if (lfs->pool.count) {
+        if (lfs->cfg->pool_buffer) {
+            lfs->pool.buffer = lfs->cfg->pool_buffer;
+        } else {
+            lfs->pool.buffer = lfs_malloc(lfs->pool.count*lfs->pool.size);
+            if (!lfs->pool.buffer) {
+                err = LFS_ERR_NOMEM;
+                goto cleanup;
+            }
+        }
+    }
+
     // setup default state
+    lfs->flags = lfs->cfg->mount_flags;
     lfs->root[0] = LFS_BLOCK_NULL;
     lfs->root[1] = LFS_BLOCK_NULL;
     lfs->mlist = NULL;
@@ -3500,6 +5949,14 @@ static int lfs_deinit(lfs_t *lfs) {
         lfs_free(lfs->free.buffer);
     }
 
+    if (!lfs->cfg->index_buffer) {
+        lfs_free(lfs->index.buffer);
+    }
+
+    if (!lfs->cfg->pool_buffer) {
+        lfs_free(lfs->pool.buffer);
+    }
+
     return 0;
 }
 
@@ -3511,15 +5968,15 @@ int lfs_format(lfs_t *lfs, const struct lfs_config *cfg) {
                 ".block_cycles=%"PRIu32", .cache_size=%"PRIu32", "
                 ".lookahead_size=%"PRIu32", .read_buffer=%p, "
                 ".prog_buffer=%p, .lookahead_buffer=%p, "
-                ".name_max=%"PRIu32", .file_max=%"PRIu32", "
-                ".attr_max=%"PRIu32"})",
+                ".name_max=%"PRIu32", .file_max=%"LFS_PRIuFOFF", "
+                ".attr_max=%"PRIu32", .mount_flags=%"PRIx32"})",
             (void*)lfs, (void*)cfg, cfg->context,
             (void*)(uintptr_t)cfg->read, (void*)(uintptr_t)cfg->prog,
             (void*)(uintptr_t)cfg->erase, (void*)(uintptr_t)cfg->sync,
             cfg->read_size, cfg->prog_size, cfg->block_size, cfg->block_count,
             cfg->block_cycles, cfg->cache_size, cfg->lookahead_size,
             cfg->read_buffer, cfg->prog_buffer, cfg->lookahead_buffer,
-            cfg->name_max, cfg->file_max, cfg->attr_max);
+            cfg->name_max, cfg->file_max, cfg->attr_max, cfg->mount_flags);
     int err = 0;
     {
         err = lfs_init(lfs, cfg);
@@ -3543,45 +6000,198 @@ int lfs_format(lfs_t *lfs, const struct lfs_config *cfg) {
             goto cleanup;
         }
 
-        // write one superblock
-        lfs_superblock_t superblock = {
-            .version     = LFS_DISK_VERSION,
-            .block_size  = lfs->cfg->block_size,
-            .block_count = lfs->cfg->block_count,
-            .name_max    = lfs->name_max,
-            .file_max    = lfs->file_max,
-            .attr_max    = lfs->attr_max,
-        };
+        // write one superblock
+        lfs_superblock_t superblock = {
+            .version     = LFS_DISK_VERSION,
+            .block_size  = lfs->cfg->block_size,
+            .block_count = lfs->cfg->block_count,
+            .name_max    = lfs->name_max,
+            .file_max    = lfs_offmin(lfs->file_max, 0xffffffff),
+            .attr_max    = lfs->attr_max,
+            .patch_max   = lfs->patch_max,
+        };
+
+        lfs_superblock_tole32(&superblock);
+        err = lfs_dir_commit(lfs, &root, LFS_MKATTRS(
+                {LFS_MKTAG(LFS_TYPE_CREATE, 0, 0), NULL},
+                {LFS_MKTAG(LFS_TYPE_SUPERBLOCK, 0, 8), "littlefs"},
+                {LFS_MKTAG(LFS_TYPE_INLINESTRUCT, 0, sizeof(superblock)),
+                    &superblock}));
+        if (err) {
+            goto cleanup;
+        }
+
+        // sanity check that fetch works
+        err = lfs_dir_fetch(lfs, &root, (const lfs_block_t[2]){0, 1});
+        if (err) {
+            goto cleanup;
+        }
+
+        // force compaction to prevent accidentally mounting any
+        // older version of littlefs that may live on disk
+        root.erased = false;
+        err = lfs_dir_commit(lfs, &root, NULL, 0);
+        if (err) {
+            goto cleanup;
+        }
+    }
+
+cleanup:
+    lfs_deinit(lfs);
+    LFS_TRACE("lfs_format -> %d", err);
+    return err;
+}
+
+static int lfs_fs_fetchsuperblock(lfs_t *lfs,
+        lfs_mdir_t *dir, const lfs_block_t pair[2]) {
+    lfs_stag_t tag = lfs_dir_fetchmatch(lfs, dir, pair,
+            LFS_MKTAG(0x7ff, 0x3ff, 0),
+            LFS_MKTAG(LFS_TYPE_SUPERBLOCK, 0, 8),
+            NULL,
+            lfs_dir_find_match, &(struct lfs_dir_find_match){
+                lfs, "littlefs", 8});
+    if (tag < 0) {
+        return tag;
+    }
+
+    // has superblock?
+    if (!tag || lfs_tag_isdelete(tag)) {
+        return false;
+    }
+
+    // update root
+    lfs->root[0] = dir->pair[0];
+    lfs->root[1] = dir->pair[1];
+
+    // grab superblock
+    lfs_superblock_t superblock;
+    tag = lfs_dir_get(lfs, dir, LFS_MKTAG(0x7ff, 0x3ff, 0),
+            LFS_MKTAG(LFS_TYPE_INLINESTRUCT, 0, sizeof(superblock)),
+            &superblock);
+    if (tag < 0) {
+        return tag;
+    }
+    lfs_superblock_fromle32(&superblock);
+
+    // check version
+    uint16_t major_version = (0xffff & (superblock.version >> 16));
+    uint16_t minor_version = (0xffff & (superblock.version >>  0));
+    if ((major_version != LFS_DISK_VERSION_MAJOR ||
+         minor_version > LFS_DISK_VERSION_MINOR)) {
+        LFS_ERROR("Invalid version %"PRIu16".%"PRIu16,
+                major_version, minor_version);
+        return LFS_ERR_INVAL;
+    }
+
+    // older minor versions are updated before our first write
+    if (minor_version < LFS_DISK_VERSION_MINOR) {
+        lfs->flags |= LFS_M_OUTDATED;
+    }
+
+    // check superblock configuration
+    if (superblock.name_max) {
+        if (superblock.name_max > lfs->name_max) {
+            LFS_ERROR("Unsupported name_max (%"PRIu32" > %"PRIu32")",
+                    superblock.name_max, lfs->name_max);
+            return LFS_ERR_INVAL;
+        }
+
+        lfs->name_max = superblock.name_max;
+    }
+
+    if (superblock.file_max) {
+        lfs_foff_t file_max = superblock.file_max;
+#ifdef LFS_OFF64
+        if (file_max == 0xffffffff) {
+            // limits past 32-bits don't fit in the superblock, so we can
+            // only check that ours is just as large
+            file_max = lfs_offmax(lfs->file_max, 0xffffffff);
+        }
+#endif
+        if (file_max > lfs->file_max) {
+            LFS_ERROR("Unsupported file_max (%"LFS_PRIuFOFF" > %"LFS_PRIuFOFF")",
+                    file_max, lfs->file_max);
+            return LFS_ERR_INVAL;
+        }
+
+        lfs->file_max = file_max;
+    }
 
-        lfs_superblock_tole32(&superblock);
-        err = lfs_dir_commit(lfs, &root, LFS_MKATTRS(
-                {LFS_MKTAG(LFS_TYPE_CREATE, 0, 0), NULL},
-                {LFS_MKTAG(LFS_TYPE_SUPERBLOCK, 0, 8), "littlefs"},
-                {LFS_MKTAG(LFS_TYPE_INLINESTRUCT, 0, sizeof(superblock)),
-                    &superblock}));
-        if (err) {
-            goto cleanup;
+    if (superblock.attr_max) {
+        if (superblock.attr_max > lfs->attr_max) {
+            LFS_ERROR("Unsupported attr_max (%"PRIu32" > %"PRIu32")",
+                    superblock.attr_max, lfs->attr_max);
+            return LFS_ERR_INVAL;
         }
 
-        // sanity check that fetch works
-        err = lfs_dir_fetch(lfs, &root, (const lfs_block_t[2]){0, 1});
-        if (err) {
-            goto cleanup;
+        lfs->attr_max = superblock.attr_max;
+    }
+
+    // superblocks from before patch_max was recorded never hold patches,
+    // but a 2.0 filesystem takes our patch_max when it is updated
+    if (minor_version == LFS_DISK_VERSION_MINOR) {
+        if (superblock.patch_max > lfs->patch_max) {
+            if (!(lfs->flags & LFS_M_RDONLY)) {
+                LFS_ERROR("Unsupported patch_max (%"PRIu32" > %"PRIu32")",
+                        superblock.patch_max, lfs->patch_max);
+                return LFS_ERR_INVAL;
+            }
+
+            // read-only, we can still open any files with fewer patches
+        } else {
+            lfs->patch_max = superblock.patch_max;
         }
+    }
 
-        // force compaction to prevent accidentally mounting any
-        // older version of littlefs that may live on disk
-        root.erased = false;
-        err = lfs_dir_commit(lfs, &root, NULL, 0);
-        if (err) {
-            goto cleanup;
+    return true;
+}
+
+static int lfs_fs_loadckpt(lfs_t *lfs, const lfs_mdir_t *dir) {
+    struct lfs_checkpoint ckpt;
+    lfs_stag_t tag = lfs_dir_get(lfs, dir, LFS_MKTAG(0x7ff, 0, 0),
+            LFS_MKTAG(LFS_TYPE_CHECKPOINT, 0, sizeof(ckpt)), &ckpt);
+    if (tag < 0) {
+        return (tag == LFS_ERR_NOENT) ? false : tag;
+    }
+
+    // any checkpoint on disk must be dropped before our next commit
+    lfs->flags |= LFS_M_HASCKPT;
+
+    if (lfs_tag_size(tag) != sizeof(ckpt)) {
+        // unknown checkpoint format, fall back to a full scan
+        return false;
+    }
+    lfs_checkpoint_fromle32(&ckpt);
+
+    // the checkpoint is only current for the revision of the superblock
+    // pair it was committed to, compacting the pair makes it stale
+    if (ckpt.rev != dir->rev) {
+        LFS_WARN("Stale checkpoint rev %"PRIu32" (expected %"PRIu32")",
+                ckpt.rev, dir->rev);
+        return false;
+    }
+
+    // root must still hold the superblock
+    if (lfs_pair_isnull(lfs->root) &&
+            ckpt.root[0] < lfs->cfg->block_count &&
+            ckpt.root[1] < lfs->cfg->block_count) {
+        lfs_mdir_t root;
+        int res = lfs_fs_fetchsuperblock(lfs, &root, ckpt.root);
+        if (res < 0 && res != LFS_ERR_CORRUPT) {
+            return res;
         }
     }
 
-cleanup:
-    lfs_deinit(lfs);
-    LFS_TRACE("lfs_format -> %d", err);
-    return err;
+    if (lfs_pair_cmp(lfs->root, ckpt.root) != 0) {
+        LFS_WARN("Stale checkpoint %"PRIx32" %"PRIx32,
+                ckpt.root[0], ckpt.root[1]);
+        return false;
+    }
+
+    // use the checkpoint's state in place of scanning
+    lfs->gpending = ckpt.gstate;
+    lfs->free.off = ckpt.lookahead % lfs->cfg->block_count;
+    return true;
 }
 
 int lfs_mount(lfs_t *lfs, const struct lfs_config *cfg) {
@@ -3592,15 +6202,15 @@ int lfs_mount(lfs_t *lfs, const struct lfs_config *cfg) {
                 ".block_cycles=%"PRIu32", .cache_size=%"PRIu32", "
                 ".lookahead_size=%"PRIu32", .read_buffer=%p, "
                 ".prog_buffer=%p, .lookahead_buffer=%p, "
-                ".name_max=%"PRIu32", .file_max=%"PRIu32", "
-                ".attr_max=%"PRIu32"})",
+                ".name_max=%"PRIu32", .file_max=%"LFS_PRIuFOFF", "
+                ".attr_max=%"PRIu32", .mount_flags=%"PRIx32"})",
             (void*)lfs, (void*)cfg, cfg->context,
             (void*)(uintptr_t)cfg->read, (void*)(uintptr_t)cfg->prog,
             (void*)(uintptr_t)cfg->erase, (void*)(uintptr_t)cfg->sync,
             cfg->read_size, cfg->prog_size, cfg->block_size, cfg->block_count,
             cfg->block_cycles, cfg->cache_size, cfg->lookahead_size,
             cfg->read_buffer, cfg->prog_buffer, cfg->lookahead_buffer,
-            cfg->name_max, cfg->file_max, cfg->attr_max);
+            cfg->name_max, cfg->file_max, cfg->attr_max, cfg->mount_flags);
     int err = lfs_init(lfs, cfg);
     if (err) {
         LFS_TRACE("lfs_mount -> %d", err);
@@ -3609,80 +6219,35 @@ int lfs_mount(lfs_t *lfs, const struct lfs_config *cfg) {
 
     // scan directory blocks for superblock and any global updates
     lfs_mdir_t dir = {.tail = {0, 1}};
+    bool ckpt = false;
     while (!lfs_pair_isnull(dir.tail)) {
         // fetch next block in tail list
-        lfs_stag_t tag = lfs_dir_fetchmatch(lfs, &dir, dir.tail,
-                LFS_MKTAG(0x7ff, 0x3ff, 0),
-                LFS_MKTAG(LFS_TYPE_SUPERBLOCK, 0, 8),
-                NULL,
-                lfs_dir_find_match, &(struct lfs_dir_find_match){
-                    lfs, "littlefs", 8});
-        if (tag < 0) {
-            err = tag;
+        int res = lfs_fs_fetchsuperblock(lfs, &dir, dir.tail);
+        if (res < 0) {
+            err = res;
             goto cleanup;
         }
 
-        // has superblock?
-        if (tag && !lfs_tag_isdelete(tag)) {
-            // update root
-            lfs->root[0] = dir.pair[0];
-            lfs->root[1] = dir.pair[1];
-
-            // grab superblock
-            lfs_superblock_t superblock;
-            tag = lfs_dir_get(lfs, &dir, LFS_MKTAG(0x7ff, 0x3ff, 0),
-                    LFS_MKTAG(LFS_TYPE_INLINESTRUCT, 0, sizeof(superblock)),
-                    &superblock);
-            if (tag < 0) {
-                err = tag;
-                goto cleanup;
-            }
-            lfs_superblock_fromle32(&superblock);
-
-            // check version
-            uint16_t major_version = (0xffff & (superblock.version >> 16));
-            uint16_t minor_version = (0xffff & (superblock.version >>  0));
-            if ((major_version != LFS_DISK_VERSION_MAJOR ||
-                 minor_version > LFS_DISK_VERSION_MINOR)) {
-                LFS_ERROR("Invalid version %"PRIu16".%"PRIu16,
-                        major_version, minor_version);
-                err = LFS_ERR_INVAL;
+        // superblock pair may have a checkpoint, which lets us skip
+        // the rest of the scan
+        if (lfs_pair_cmp(dir.pair, (const lfs_block_t[2]){0, 1}) == 0) {
+            res = lfs_fs_loadckpt(lfs, &dir);
+            if (res < 0) {
+                err = res;
                 goto cleanup;
             }
 
-            // check superblock configuration
-            if (superblock.name_max) {
-                if (superblock.name_max > lfs->name_max) {
-                    LFS_ERROR("Unsupported name_max (%"PRIu32" > %"PRIu32")",
-                            superblock.name_max, lfs->name_max);
-                    err = LFS_ERR_INVAL;
-                    goto cleanup;
-                }
-
-                lfs->name_max = superblock.name_max;
-            }
-
-            if (superblock.file_max) {
-                if (superblock.file_max > lfs->file_max) {
-                    LFS_ERROR("Unsupported file_max (%"PRIu32" > %"PRIu32")",
-                            superblock.file_max, lfs->file_max);
-                    err = LFS_ERR_INVAL;
-                    goto cleanup;
-                }
-
-                lfs->file_max = superblock.file_max;
+            if (res) {
+                ckpt = true;
+                break;
             }
+        }
 
-            if (superblock.attr_max) {
-                if (superblock.attr_max > lfs->attr_max) {
-                    LFS_ERROR("Unsupported attr_max (%"PRIu32" > %"PRIu32")",
-                            superblock.attr_max, lfs->attr_max);
-                    err = LFS_ERR_INVAL;
-                    goto cleanup;
-                }
-
-                lfs->attr_max = superblock.attr_max;
-            }
+        // lazy mounts stop at the superblock, gstate is scanned later
+        if (!lfs_pair_isnull(lfs->root) &&
+                (lfs->flags & (LFS_M_LAZY | LFS_M_RDONLY))) {
+            lfs->flags |= LFS_M_UNSCANNED;
+            break;
         }
 
         // has gstate?
@@ -3708,8 +6273,10 @@ int lfs_mount(lfs_t *lfs, const struct lfs_config *cfg) {
                 lfs_tag_id(lfs->gstate.tag));
     }
 
-    // setup free lookahead
-    lfs->free.off = lfs->seed % lfs->cfg->block_size;
+    // setup free lookahead, a checkpoint tells us where we left off
+    if (!ckpt) {
+        lfs->free.off = lfs->seed % lfs->cfg->block_size;
+    }
     lfs->free.size = 0;
     lfs->free.i = 0;
     lfs_alloc_ack(lfs);
@@ -3718,14 +6285,21 @@ int lfs_mount(lfs_t *lfs, const struct lfs_config *cfg) {
     return 0;
 
 cleanup:
-    lfs_unmount(lfs);
+    lfs_deinit(lfs);
     LFS_TRACE("lfs_mount -> %d", err);
     return err;
 }
 
 int lfs_unmount(lfs_t *lfs) {
     LFS_TRACE("lfs_unmount(%p)", (void*)lfs);
-    int err = lfs_deinit(lfs);
+    int err = 0;
+    if ((lfs->flags & LFS_M_CHECKPOINT) && !(lfs->flags & LFS_M_RDONLY)) {
+        // leave a checkpoint so the next mount can skip the scan
+        err = lfs_fs_checkpoint(lfs);
+    }
+
+    int res = lfs_deinit(lfs);
+    err = err ? err : res;
     LFS_TRACE("lfs_unmount -> %d", err);
     return err;
 }
@@ -3770,9 +6344,13 @@ int lfs_fs_traverse(lfs_t *lfs,
         }
 
         for (uint16_t id = 0; id < dir.count; id++) {
-            struct lfs_ctz ctz;
+            // unlike lfs_dir_getctz, files with more patches than we can
+            // keep track of don't stop us, we walk the patches we can see,
+            // this only happens if the filesystem's patch_max is larger
+            // than ours, which is only mounted read-only
+            uint32_t buffer[LFS_CTZ_WORDS];
             lfs_stag_t tag = lfs_dir_get(lfs, &dir, LFS_MKTAG(0x700, 0x3ff, 0),
-                    LFS_MKTAG(LFS_TYPE_STRUCT, id, sizeof(ctz)), &ctz);
+                    LFS_MKTAG(LFS_TYPE_STRUCT, id, sizeof(buffer)), buffer);
             if (tag < 0) {
                 if (tag == LFS_ERR_NOENT) {
                     continue;
@@ -3780,15 +6358,30 @@ int lfs_fs_traverse(lfs_t *lfs,
                 LFS_TRACE("lfs_fs_traverse -> %"PRId32, tag);
                 return tag;
             }
-            lfs_ctz_fromle32(&ctz);
 
-            if (lfs_tag_type3(tag) == LFS_TYPE_CTZSTRUCT) {
+            if (lfs_tag_isctz(tag)) {
+                struct lfs_ctz ctz;
+                err = lfs_ctz_fromdisk(tag, buffer, &ctz);
+                if (err) {
+                    LFS_TRACE("lfs_fs_traverse -> %d", err);
+                    return err;
+                }
+
                 err = lfs_ctz_traverse(lfs, NULL, &lfs->rcache,
-                        ctz.head, ctz.size, cb, data);
+                        ctz.head, ctz.start, ctz.size, cb, data);
                 if (err) {
                     LFS_TRACE("lfs_fs_traverse -> %d", err);
                     return err;
                 }
+
+                const struct lfs_ctzpatch *patch = LFS_CTZ_PATCH(&ctz);
+                for (lfs_size_t i = 0; i < ctz.pcount; i++) {
+                    err = cb(data, patch[i].block);
+                    if (err) {
+                        LFS_TRACE("lfs_fs_traverse -> %d", err);
+                        return err;
+                    }
+                }
             }
         }
     }
@@ -3801,16 +6394,43 @@ int lfs_fs_traverse(lfs_t *lfs,
 
         if ((f->flags & LFS_F_DIRTY) && !(f->flags & LFS_F_INLINE)) {
             int err = lfs_ctz_traverse(lfs, &f->cache, &lfs->rcache,
-                    f->ctz.head, f->ctz.size, cb, data);
+                    f->ctz.head, f->ctz.start, f->ctz.size, cb, data);
             if (err) {
                 LFS_TRACE("lfs_fs_traverse -> %d", err);
                 return err;
             }
+
+            const struct lfs_ctzpatch *patch = LFS_CTZ_PATCH(&f->ctz);
+            for (lfs_size_t i = 0; i < f->ctz.pcount; i++) {
+                err = cb(data, patch[i].block);
+                if (err) {
+                    LFS_TRACE("lfs_fs_traverse -> %d", err);
+                    return err;
+                }
+            }
         }
 
-        if ((f->flags & LFS_F_WRITING) && !(f->flags & LFS_F_INLINE)) {
+        if (f->flags & LFS_F_PATCHING) {
+            // a patch being written isn't part of the skip-list yet
+            int err = cb(data, f->block);
+            if (err) {
+                LFS_TRACE("lfs_fs_traverse -> %d", err);
+                return err;
+            }
+        } else if ((f->flags & LFS_F_WRITING) &&
+                !(f->flags & LFS_F_INLINE)) {
             int err = lfs_ctz_traverse(lfs, &f->cache, &lfs->rcache,
-                    f->block, f->pos, cb, data);
+                    f->block, f->ctz.start, f->pos, cb, data);
+            if (err) {
+                LFS_TRACE("lfs_fs_traverse -> %d", err);
+                return err;
+            }
+        }
+
+        // reserved blocks aren't part of any file yet, but can't be
+        // handed out either
+        for (lfs_size_t i = 0; i < f->reserve.count; i++) {
+            int err = cb(data, f->reserve.buffer[i]);
             if (err) {
                 LFS_TRACE("lfs_fs_traverse -> %d", err);
                 return err;
@@ -3887,6 +6507,9 @@ static lfs_stag_t lfs_fs_parent(lfs_t *lfs, const lfs_block_t pair[2],
 
 static int lfs_fs_relocate(lfs_t *lfs,
         const lfs_block_t oldpair[2], lfs_block_t newpair[2]) {
+    // drop the directory index, it may point to our old pair
+    lfs->index.off = 0;
+
     // update internal root
     if (lfs_pair_cmp(oldpair, lfs->root) == 0) {
         LFS_DEBUG("Relocating root %"PRIx32" %"PRIx32,
@@ -4066,8 +6689,137 @@ static int lfs_fs_deorphan(lfs_t *lfs) {
     return 0;
 }
 
+static int lfs_fs_scan(lfs_t *lfs) {
+    if (!(lfs->flags & LFS_M_UNSCANNED)) {
+        return 0;
+    }
+
+    // finish a lazy mount, nothing can have been committed yet so
+    // the gstate on disk is all there is
+    struct lfs_gstate gpending = {0, {0, 0}};
+    lfs_mdir_t dir = {.tail = {0, 1}};
+    while (!lfs_pair_isnull(dir.tail)) {
+        int err = lfs_dir_fetch(lfs, &dir, dir.tail);
+        if (err) {
+            return err;
+        }
+
+        err = lfs_dir_getgstate(lfs, &dir, &gpending);
+        if (err) {
+            return err;
+        }
+    }
+
+    gpending.tag += !lfs_tag_isvalid(gpending.tag);
+    lfs->gpending = gpending;
+    lfs->gstate = gpending;
+    lfs->flags &= ~LFS_M_UNSCANNED;
+    if (lfs_gstate_hasmove(&lfs->gstate)) {
+        LFS_DEBUG("Found move %"PRIx32" %"PRIx32" %"PRIx16,
+                lfs->gstate.pair[0],
+                lfs->gstate.pair[1],
+                lfs_tag_id(lfs->gstate.tag));
+    }
+
+    return 0;
+}
+
+static int lfs_fs_dropckpt(lfs_t *lfs) {
+    if (!(lfs->flags & LFS_M_HASCKPT)) {
+        return 0;
+    }
+
+    // mark the checkpoint as deleted, note this must happen before we look
+    // up anything else since it may modify the superblock pair
+    lfs_mdir_t dir;
+    int err = lfs_dir_fetch(lfs, &dir, (const lfs_block_t[2]){0, 1});
+    if (err) {
+        return err;
+    }
+
+    lfs->flags &= ~LFS_M_HASCKPT;
+    err = lfs_dir_commit(lfs, &dir, LFS_MKATTRS(
+            {LFS_MKTAG(LFS_TYPE_CHECKPOINT, 0x3ff, 0x3ff), NULL}));
+    if (err) {
+        lfs->flags |= LFS_M_HASCKPT;
+        return err;
+    }
+
+    return 0;
+}
+
+static int lfs_fs_upgrade(lfs_t *lfs) {
+    if (!(lfs->flags & LFS_M_OUTDATED)) {
+        return 0;
+    }
+
+    // bump the minor version in the superblock, older drivers can't
+    // understand everything we may write and must refuse to mount
+    lfs_mdir_t root;
+    int err = lfs_dir_fetch(lfs, &root, lfs->root);
+    if (err) {
+        return err;
+    }
+
+    lfs_superblock_t superblock;
+    lfs_stag_t tag = lfs_dir_get(lfs, &root, LFS_MKTAG(0x7ff, 0x3ff, 0),
+            LFS_MKTAG(LFS_TYPE_INLINESTRUCT, 0, sizeof(superblock)),
+            &superblock);
+    if (tag < 0) {
+        return tag;
+    }
+
+    lfs_superblock_fromle32(&superblock);
+    LFS_DEBUG("Updating version %"PRIu16".%"PRIu16" -> %"PRIu16".%"PRIu16,
+            (uint16_t)(superblock.version >> 16),
+            (uint16_t)(superblock.version >>  0),
+            LFS_DISK_VERSION_MAJOR, LFS_DISK_VERSION_MINOR);
+    superblock.version = LFS_DISK_VERSION;
+    superblock.patch_max = lfs->patch_max;
+    lfs_superblock_tole32(&superblock);
+
+    // any checkpoint is dropped in the same commit
+    uint32_t flags = lfs->flags;
+    lfs->flags &= ~(LFS_M_OUTDATED | LFS_M_HASCKPT);
+    err = lfs_dir_commit(lfs, &root, LFS_MKATTRS(
+            {(flags & LFS_M_HASCKPT)
+                ? LFS_MKTAG(LFS_TYPE_CHECKPOINT, 0x3ff, 0x3ff)
+                : LFS_MKTAG(LFS_FROM_NOOP, 0, 0), NULL},
+            {LFS_MKTAG(LFS_TYPE_INLINESTRUCT, 0, sizeof(superblock)),
+                &superblock}));
+    if (err) {
+        lfs->flags = flags;
+        return err;
+    }
+
+    return 0;
+}
+
+static int lfs_fs_prepwrite(lfs_t *lfs) {
+    if (lfs->flags & LFS_M_RDONLY) {
+        return LFS_ERR_ROFS;
+    }
+
+    int err = lfs_fs_scan(lfs);
+    if (err) {
+        return err;
+    }
+
+    err = lfs_fs_upgrade(lfs);
+    if (err) {
+        return err;
+    }
+
+    return lfs_fs_dropckpt(lfs);
+}
+
 static int lfs_fs_forceconsistency(lfs_t *lfs) {
-    int err = lfs_fs_demove(lfs);
+    int err = lfs_fs_prepwrite(lfs);
+    if (err) {
+        return err;
+    }
+
+    err = lfs_fs_demove(lfs);
     if (err) {
         return err;
     }
@@ -4100,6 +6852,157 @@ lfs_ssize_t lfs_fs_size(lfs_t *lfs) {
     return size;
 }
 
+int lfs_fs_sync(lfs_t *lfs) {
+    LFS_TRACE("lfs_fs_sync(%p)", (void*)lfs);
+    // write out any file data first
+    for (lfs_file_t *f = (lfs_file_t*)lfs->mlist; f; f = f->next) {
+        if (f->type == LFS_TYPE_REG && (f->flags & LFS_F_WRITING)) {
+            int err = lfs_file_flush(lfs, f);
+            if (err) {
+                f->flags |= LFS_F_ERRED;
+                LFS_TRACE("lfs_fs_sync -> %d", err);
+                return err;
+            }
+        }
+
+        if (f->type == LFS_TYPE_REG) {
+            lfs_file_ringdrop(lfs, f);
+        }
+    }
+
+    // commit dirty files, one commit per metadata pair
+    for (lfs_file_t *f = (lfs_file_t*)lfs->mlist; f; f = f->next) {
+        if (!(f->type == LFS_TYPE_REG &&
+                (f->flags & LFS_F_DIRTY) &&
+                !(f->flags & LFS_F_ERRED) &&
+                !lfs_pair_isnull(f->m.pair))) {
+            continue;
+        }
+
+        // drop checkpoint if we haven't yet
+        int err = lfs_fs_prepwrite(lfs);
+        if (err) {
+            LFS_TRACE("lfs_fs_sync -> %d", err);
+            return err;
+        }
+
+        // gather every dirty file in this pair, same as lfs_file_sync
+        lfs_file_t *group[LFS_BATCH_MAX/3];
+        uint32_t ctzs[LFS_BATCH_MAX/3][LFS_CTZ_WORDS];
+        struct lfs_mattr attrs[LFS_BATCH_MAX];
+        int count = 0;
+        bool inlined = false;
+        for (lfs_file_t *g = f; g && count < LFS_BATCH_MAX/3; g = g->next) {
+            if (!(g->type == LFS_TYPE_REG &&
+                    (g->flags & LFS_F_DIRTY) &&
+                    !(g->flags & LFS_F_ERRED) &&
+                    lfs_pair_cmp(g->m.pair, f->m.pair) == 0)) {
+                continue;
+            }
+
+            if (g->flags & LFS_F_INLINE) {
+                // inline the whole file
+                inlined = true;
+                attrs[3*count+0] = (struct lfs_mattr){
+                        LFS_MKTAG(LFS_TYPE_INLINESTRUCT, g->id,
+                            lfs_min(g->ctz.size, 0x3fe)),
+                        g->cache.buffer};
+            } else {
+                // copy ctz so alloc will work during a relocate
+                attrs[3*count+0] = (struct lfs_mattr){
+                        lfs_ctz_todisk(&g->ctz, g->id, ctzs[count]),
+                        ctzs[count]};
+            }
+            attrs[3*count+1] = (struct lfs_mattr){
+                    LFS_MKTAG(LFS_FROM_INLINE, g->id,
+                        lfs_min(lfs->inline_max / 0x3fe, 0x40)), g};
+            attrs[3*count+2] = (struct lfs_mattr){
+                    LFS_MKTAG(LFS_FROM_USERATTRS, g->id, g->cfg->attr_count),
+                    g->cfg->attrs};
+            group[count] = g;
+            count += 1;
+        }
+
+        // commit, leaving the device sync until everything is written
+        lfs->flags |= LFS_M_NOSYNC;
+        err = lfs_dir_commit(lfs, &f->m, attrs, 3*count);
+        lfs->flags &= ~LFS_M_NOSYNC;
+        if (err == LFS_ERR_NOSPC && inlined) {
+            // inline files don't fit, fall back to syncing each file
+            // on its own, which moves them out of the pair if needed
+            for (int i = 0; i < count; i++) {
+                err = lfs_file_sync(lfs, group[i]);
+                if (err) {
+                    LFS_TRACE("lfs_fs_sync -> %d", err);
+                    return err;
+                }
+            }
+            continue;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (err) {
+                group[i]->flags |= LFS_F_ERRED;
+            } else {
+                group[i]->flags &= ~LFS_F_DIRTY;
+            }
+        }
+
+        if (err) {
+            LFS_TRACE("lfs_fs_sync -> %d", err);
+            return err;
+        }
+    }
+
+    int err = lfs_bd_sync(lfs, &lfs->pcache, &lfs->rcache, false);
+    LFS_TRACE("lfs_fs_sync -> %d", err);
+    return err;
+}
+
+int lfs_fs_checkpoint(lfs_t *lfs) {
+    LFS_TRACE("lfs_fs_checkpoint(%p)", (void*)lfs);
+    if (lfs->flags & LFS_M_HASCKPT) {
+        // nothing has changed
+        LFS_TRACE("lfs_fs_checkpoint -> %d", 0);
+        return 0;
+    }
+
+    // only checkpoint a consistent filesystem, this keeps the gstate simple
+    int err = lfs_fs_forceconsistency(lfs);
+    if (err) {
+        LFS_TRACE("lfs_fs_checkpoint -> %d", err);
+        return err;
+    }
+
+    lfs_mdir_t dir;
+    err = lfs_dir_fetch(lfs, &dir, (const lfs_block_t[2]){0, 1});
+    if (err) {
+        LFS_TRACE("lfs_fs_checkpoint -> %d", err);
+        return err;
+    }
+
+    // if this commit compacts the pair the checkpoint is stamped with the
+    // new revision instead
+    struct lfs_checkpoint ckpt = {
+        .root = {lfs->root[0], lfs->root[1]},
+        .gstate = lfs->gstate,
+        .lookahead = (lfs->free.off + lfs->free.i) % lfs->cfg->block_count,
+        .rev = dir.rev,
+    };
+
+    lfs_checkpoint_tole32(&ckpt);
+    err = lfs_dir_commit(lfs, &dir, LFS_MKATTRS(
+            {LFS_MKTAG(LFS_TYPE_CHECKPOINT, 0x3ff, sizeof(ckpt)), &ckpt}));
+    if (err) {
+        LFS_TRACE("lfs_fs_checkpoint -> %d", err);
+        return err;
+    }
+
+    lfs->flags |= LFS_M_HASCKPT;
+    LFS_TRACE("lfs_fs_checkpoint -> %d", 0);
+    return 0;
+}
+
 #ifdef LFS_MIGRATE
 ////// Migration from littelfs v1 below this //////
 
@@ -4378,7 +7281,8 @@ int lfs1_traverse(lfs_t *lfs, int (*cb)(void*, lfs_block_t), void *data) {
             dir.off += lfs1_entry_size(&entry);
             if ((0x70 & entry.d.type) == (0x70 & LFS1_TYPE_REG)) {
                 err = lfs_ctz_traverse(lfs, NULL, &lfs->rcache,
-                        entry.d.u.file.head, entry.d.u.file.size, cb, data);
+                        entry.d.u.file.head, 0, entry.d.u.file.size,
+                        cb, data);
                 if (err) {
                     return err;
                 }
@@ -4528,15 +7432,15 @@ int lfs_migrate(lfs_t *lfs, const struct lfs_config *cfg) {
                 ".block_cycles=%"PRIu32", .cache_size=%"PRIu32", "
                 ".lookahead_size=%"PRIu32", .read_buffer=%p, "
                 ".prog_buffer=%p, .lookahead_buffer=%p, "
-                ".name_max=%"PRIu32", .file_max=%"PRIu32", "
-                ".attr_max=%"PRIu32"})",
+                ".name_max=%"PRIu32", .file_max=%"LFS_PRIuFOFF", "
+                ".attr_max=%"PRIu32", .mount_flags=%"PRIx32"})",
             (void*)lfs, (void*)cfg, cfg->context,
             (void*)(uintptr_t)cfg->read, (void*)(uintptr_t)cfg->prog,
             (void*)(uintptr_t)cfg->erase, (void*)(uintptr_t)cfg->sync,
             cfg->read_size, cfg->prog_size, cfg->block_size, cfg->block_count,
             cfg->block_cycles, cfg->cache_size, cfg->lookahead_size,
             cfg->read_buffer, cfg->prog_buffer, cfg->lookahead_buffer,
-            cfg->name_max, cfg->file_max, cfg->attr_max);
+            cfg->name_max, cfg->file_max, cfg->attr_max, cfg->mount_flags);
     struct lfs1 lfs1;
     int err = lfs1_mount(lfs, &lfs1, cfg);
     if (err) {
@@ -4725,8 +7629,9 @@ int lfs_migrate(lfs_t *lfs, const struct lfs_config *cfg) {
             .block_size  = lfs->cfg->block_size,
             .block_count = lfs->cfg->block_count,
             .name_max    = lfs->name_max,
-            .file_max    = lfs->file_max,
+            .file_max    = lfs_offmin(lfs->file_max, 0xffffffff),
             .attr_max    = lfs->attr_max,
+            .patch_max   = lfs->patch_max,
         };
 
         lfs_superblock_tole32(&superblock);
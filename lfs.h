@@ -28,7 +28,7 @@ extern "C"
 // Version of On-disk data structures
 // Major (top-nibble), incremented on backwards incompatible changes
 // Minor (bottom-nibble), incremented on feature additions
-#define LFS_DISK_VERSION 0x00020000
+#define LFS_DISK_VERSION 0x00020001
 #define LFS_DISK_VERSION_MAJOR (0xffff & (LFS_DISK_VERSION >> 16))
 #define LFS_DISK_VERSION_MINOR (0xffff & (LFS_DISK_VERSION >>  0))
 
@@ -42,6 +42,22 @@ typedef uint32_t lfs_off_t;
 typedef int32_t  lfs_ssize_t;
 typedef int32_t  lfs_soff_t;
 
+// Offsets into files, these can be widened to 64-bits with LFS_OFF64 for
+// files larger than 2 GiB. This widens the seek, tell, size, and truncate
+// functions along with file sizes in the info structs, offsets into blocks
+// and the block device functions stay 32-bits.
+#ifdef LFS_OFF64
+typedef uint64_t lfs_foff_t;
+typedef int64_t  lfs_sfoff_t;
+#define LFS_PRIuFOFF PRIu64
+#define LFS_PRIdFOFF PRId64
+#else
+typedef uint32_t lfs_foff_t;
+typedef int32_t  lfs_sfoff_t;
+#define LFS_PRIuFOFF PRIu32
+#define LFS_PRIdFOFF PRId32
+#endif
+
 typedef uint32_t lfs_block_t;
 
 // Maximum name size in bytes, may be redefined to reduce the size of the
@@ -52,13 +68,18 @@ typedef uint32_t lfs_block_t;
 #endif
 
 // Maximum size of a file in bytes, may be redefined to limit to support other
-// drivers. Limited on disk to <= 4294967296. However, above 2147483647 the
-// functions lfs_file_seek, lfs_file_size, and lfs_file_tell will return
-// incorrect values due to using signed integers. Stored in superblock and
-// must be respected by other littlefs drivers.
+// drivers. Limited to the range of lfs_sfoff_t, 2147483647 by default and
+// 9223372036854775807 with LFS_OFF64. Stored in superblock and must be
+// respected by other littlefs drivers. The superblock only has room for
+// 32-bits, larger limits are stored as 4294967295, which drivers without
+// LFS_OFF64 will refuse to mount.
 #ifndef LFS_FILE_MAX
+#ifdef LFS_OFF64
+#define LFS_FILE_MAX 9223372036854775807
+#else
 #define LFS_FILE_MAX 2147483647
 #endif
+#endif
 
 // Maximum size of custom attributes in bytes, may be redefined, but there is
 // no real benefit to using a smaller LFS_ATTR_MAX. Limited to <= 1022.
@@ -66,6 +87,46 @@ typedef uint32_t lfs_block_t;
 #define LFS_ATTR_MAX 1022
 #endif
 
+// Maximum number of metadata attributes a batch can hold, may be redefined
+// to change the size of the batch struct. Each batched operation uses up to
+// 3 attributes.
+#ifndef LFS_BATCH_MAX
+#define LFS_BATCH_MAX 64
+#endif
+
+// Number of name bytes the directory index keeps for each metadata pair, may
+// be redefined. Longer keys cost RAM but tell apart names with long common
+// prefixes. Should be a multiple of 4.
+#ifndef LFS_INDEX_KEY
+#define LFS_INDEX_KEY 20
+#endif
+
+// Number of skip-list levels a file remembers while it is written, may be
+// redefined. Appending a block only reads back pointers above this level,
+// which happens once every 2^LFS_CTZ_DEPTH blocks. Each level costs 8 bytes
+// in every lfs_file_t, 16 with LFS_OFF64. Setting this to 0 removes the
+// stack and appends read back every pointer they write.
+#ifndef LFS_CTZ_DEPTH
+#define LFS_CTZ_DEPTH 8
+#endif
+
+// Maximum number of appends a file's journal can hold before it is merged
+// into the file's blocks, may be redefined. Merging deletes each journaled
+// append in a single commit, so this costs stack. Limited to <= 128.
+#ifndef LFS_JOURNAL_MAX
+#define LFS_JOURNAL_MAX 16
+#endif
+
+// Maximum number of blocks a file can replace in place before writes inside
+// the file fall back to rewriting everything after the write, may be
+// redefined. Each patch costs 8 bytes of RAM in every lfs_file_t, whether it
+// is used or not, and 8 bytes in the metadata entry of files that use it.
+// Setting this to 0 removes the patch table and writes inside a file always
+// rewrite everything after the write. Limited to <= 64.
+#ifndef LFS_PATCH_MAX
+#define LFS_PATCH_MAX 4
+#endif
+
 // Possible error codes, these are negative to allow
 // valid positive return values
 enum lfs_error {
@@ -84,6 +145,7 @@ enum lfs_error {
     LFS_ERR_NOMEM       = -12,  // No more memory available
     LFS_ERR_NOATTR      = -61,  // No data/attr available
     LFS_ERR_NAMETOOLONG = -36,  // File name too long
+    LFS_ERR_ROFS        = -30,  // Filesystem is mounted read-only
 };
 
 // File types
@@ -108,15 +170,20 @@ enum lfs_type {
     LFS_TYPE_SUPERBLOCK     = 0x0ff,
     LFS_TYPE_DIRSTRUCT      = 0x200,
     LFS_TYPE_CTZSTRUCT      = 0x202,
+    LFS_TYPE_CTZ64STRUCT    = 0x203,
     LFS_TYPE_INLINESTRUCT   = 0x201,
     LFS_TYPE_SOFTTAIL       = 0x600,
     LFS_TYPE_HARDTAIL       = 0x601,
     LFS_TYPE_MOVESTATE      = 0x7ff,
+    LFS_TYPE_CHECKPOINT     = 0x7fe,
+    LFS_TYPE_INLINECHUNK    = 0x140,
+    LFS_TYPE_JOURNAL        = 0x180,
 
     // internal chip sources
     LFS_FROM_NOOP           = 0x000,
     LFS_FROM_MOVE           = 0x101,
     LFS_FROM_USERATTRS      = 0x102,
+    LFS_FROM_INLINE         = 0x103,
 };
 
 // File open flags
@@ -137,6 +204,22 @@ enum lfs_open_flags {
     LFS_F_ERRED   = 0x080000, // An error occured during write
     LFS_F_INLINE  = 0x100000, // Currently inlined in directory entry
     LFS_F_OPENED  = 0x200000, // File has been opened
+    LFS_F_MERGING = 0x400000, // Journal is being merged into the file
+    LFS_F_PATCHING = 0x800000, // Writing a replacement for a single block
+};
+
+// Mount flags
+enum lfs_mount_flags {
+    // mount flags
+    LFS_M_CHECKPOINT = 0x1,     // Write a mount checkpoint during unmount
+    LFS_M_LAZY       = 0x2,     // Defer the global state scan until a write
+    LFS_M_RDONLY     = 0x4,     // Skip the global state scan, reject writes
+
+    // internally used flags
+    LFS_M_HASCKPT    = 0x010000, // Checkpoint on disk matches storage
+    LFS_M_UNSCANNED  = 0x020000, // Global state has not been scanned
+    LFS_M_NOSYNC     = 0x040000, // Commits leave the device sync to the caller
+    LFS_M_OUTDATED   = 0x080000, // Superblock has an older minor version
 };
 
 // File seek flags
@@ -234,12 +317,72 @@ struct lfs_config {
     // Optional upper limit on files in bytes. No downside for larger files
     // but must be <= LFS_FILE_MAX. Defaults to LFS_FILE_MAX when zero. Stored
     // in superblock and must be respected by other littlefs drivers.
-    lfs_size_t file_max;
+    lfs_foff_t file_max;
 
     // Optional upper limit on custom attributes in bytes. No downside for
     // larger attributes size but must be <= LFS_ATTR_MAX. Defaults to
     // LFS_ATTR_MAX when zero.
     lfs_size_t attr_max;
+
+    // Optional flags that change how the filesystem is mounted, values from
+    // the enum lfs_mount_flags bitwise-ored together. Defaults to none when
+    // zero.
+    uint32_t mount_flags;
+
+    // Optional size of the directory index in bytes. The index remembers the
+    // metadata pairs of large directories and the last name in each, letting
+    // lookups skip straight to the pair that may hold a name instead of
+    // scanning every pair in turn. Each indexed pair takes
+    // sizeof(lfs_index_entry_t) bytes, plus one entry per directory.
+    // Defaults to no index when zero.
+    lfs_size_t index_size;
+
+    // Optional statically allocated index buffer. Must be index_size and
+    // aligned to a 32-bit boundary. By default lfs_malloc is used to allocate
+    // this buffer.
+    void *index_buffer;
+
+    // Optional upper limit on inline files in bytes. Files this small are
+    // stored directly in their directory's metadata pair, spanning several
+    // tags if needed, instead of taking up a block of their own. An inline
+    // file is held in the file's buffer while open, so file buffers grow to
+    // inline_max if it is larger than cache_size. Must be <= block_size/2,
+    // though values above block_size/8 leave little room for the rest of the
+    // directory. Defaults to the smallest of cache_size, block_size/8, and
+    // 1022 when zero.
+    lfs_size_t inline_max;
+
+    // Optional number of file buffers shared by open files. Files opened
+    // without a buffer of their own borrow one from this pool only while
+    // reading or writing, taking the least recently used buffer from another
+    // file if none are free, so many files can be open without each pinning
+    // a buffer. Files that are reading or idle give up their buffer first,
+    // a file with unwritten data is only flushed if every buffer is held by
+    // a writer. That flush happens on behalf of another file, so with a pool
+    // any read or write may return an error from writing out a different
+    // file's data, which is then marked as errored. Inline files keep their
+    // buffer while they have unsynced changes, so this must be larger than
+    // the number of those open at once. Defaults to allocating a buffer for
+    // each open file when zero.
+    lfs_size_t pool_count;
+
+    // Optional statically allocated pool buffer. Must be pool_count times
+    // cache_size, or inline_max if larger. By default lfs_malloc is used to
+    // allocate this buffer.
+    void *pool_buffer;
+
+    // Optional direct mapping for memory-mapped block devices. Returns a
+    // pointer to an offset in a block, which must stay valid and readable up
+    // to the end of the block, or NULL if the block can't be mapped. Only
+    // used by lfs_file_map. Defaults to no mapping when NULL.
+    const void *(*map)(const struct lfs_config *c,
+            lfs_block_t block, lfs_off_t off);
+
+    // Optional upper limit on the number of blocks a file can replace in
+    // place. No downside for more patches but must be <= LFS_PATCH_MAX.
+    // Defaults to LFS_PATCH_MAX when zero. Stored in superblock and must be
+    // respected by other littlefs drivers.
+    lfs_size_t patch_max;
 };
 
 // File info structure
@@ -247,8 +390,9 @@ struct lfs_info {
     // Type of the file, either LFS_TYPE_REG or LFS_TYPE_DIR
     uint8_t type;
 
-    // Size of the file, only valid for REG files. Limited to 32-bits.
-    lfs_size_t size;
+    // Size of the file, only valid for REG files. Limited to 32-bits unless
+    // LFS_OFF64 is defined.
+    lfs_foff_t size;
 
     // Name of the file stored as a null-terminated string. Limited to
     // LFS_NAME_MAX+1, which can be changed by redefining LFS_NAME_MAX to
@@ -257,6 +401,37 @@ struct lfs_info {
     char name[LFS_NAME_MAX+1];
 };
 
+// Packed directory entry, filled out by lfs_dir_readbulk
+struct lfs_dirent {
+    // Type of the file, either LFS_TYPE_REG or LFS_TYPE_DIR
+    uint8_t type;
+
+    // Size of the file, only valid for REG files. Limited to 32-bits unless
+    // LFS_OFF64 is defined.
+    lfs_foff_t size;
+
+    // Name of the file stored as a null-terminated string in the buffer
+    // passed to lfs_dir_readbulk.
+    const char *name;
+
+    // Requested custom attribute stored in the buffer passed to
+    // lfs_dir_readbulk, or NULL if the file doesn't have it.
+    const void *attr;
+
+    // Size of the custom attribute in bytes
+    lfs_size_t attr_size;
+};
+
+// Directory position, filled out by lfs_dir_tellcookie
+struct lfs_dircookie {
+    lfs_block_t head[2];
+    lfs_block_t pair[2];
+    uint32_t rev;
+    lfs_off_t off;
+    uint16_t id;
+    lfs_off_t pos;
+};
+
 // Custom attribute structure, used to describe custom attributes
 // committed atomically during file writes.
 struct lfs_attr {
@@ -273,8 +448,9 @@ struct lfs_attr {
 
 // Optional configuration provided during lfs_file_opencfg
 struct lfs_file_config {
-    // Optional statically allocated file buffer. Must be cache_size.
-    // By default lfs_malloc is used to allocate this buffer.
+    // Optional statically allocated file buffer. Must be cache_size, or
+    // inline_max if larger. By default lfs_malloc is used to allocate this
+    // buffer, or one is borrowed from the pool if pool_count is set.
     void *buffer;
 
     // Optional list of custom attributes related to the file. If the file
@@ -292,6 +468,48 @@ struct lfs_file_config {
 
     // Number of custom attributes in the list
     lfs_size_t attr_count;
+
+    // Optional block index, speeds up random access to large files. The
+    // addresses of blocks found while seeking are remembered here, so later
+    // lookups can start from the closest known block instead of walking the
+    // skip-list from the end of the file. Each entry is 4 bytes, if the file
+    // has more blocks than entries, only every other known block is kept.
+    // Must be aligned to a 32-bit boundary.
+    void *index_buffer;
+
+    // Size of the optional block index in bytes.
+    lfs_size_t index_size;
+
+    // Optional append journal size in bytes. Small appends to the end of
+    // the file are committed directly to the file's metadata pair instead of
+    // its blocks, which avoids copying the last block on every sync.
+    // Each journaled write is committed immediately, so records should be
+    // written whole. Once the journal is full, or the file is written
+    // anywhere else, the journal is merged into the file's blocks. Limited
+    // to block_size/8, zero disables the journal. This only helps when
+    // appends don't end on prog_size boundaries, appends that do are
+    // already programmed in place and journaling them costs a little more.
+    lfs_size_t journal_size;
+
+    // Optional statically allocated buffer for blocks reserved with
+    // lfs_file_reserve. Each entry is 4 bytes and must be aligned to a
+    // 32-bit boundary. By default lfs_malloc is used to allocate this
+    // buffer as needed.
+    void *reserve_buffer;
+
+    // Size of the optional reservation buffer in bytes.
+    lfs_size_t reserve_size;
+
+    // Optional ring size in bytes, turns the file into a rolling log. When
+    // the file is synced and holds more than this, the oldest data is
+    // dropped from the front of the file so only the last ring_size bytes
+    // remain. This only moves the file's start forward, blocks that no
+    // longer hold any data are freed without copying anything. File
+    // positions are relative to the oldest data still in the file, so
+    // they shift as data is dropped. Only the data still in the file
+    // counts against file_max, but at most 4GiB can ever be written to a
+    // ring file unless LFS_OFF64 is defined. Zero disables the ring.
+    lfs_size_t ring_size;
 };
 
 
@@ -314,6 +532,18 @@ typedef struct lfs_mdir {
     lfs_block_t tail[2];
 } lfs_mdir_t;
 
+struct lfs_mattr {
+    uint32_t tag;
+    const void *buffer;
+};
+
+// littlefs batch type
+typedef struct lfs_batch {
+    lfs_mdir_t m;
+    lfs_size_t attrcount;
+    struct lfs_mattr attrs[LFS_BATCH_MAX];
+} lfs_batch_t;
+
 // littlefs directory type
 typedef struct lfs_dir {
     struct lfs_dir *next;
@@ -325,6 +555,16 @@ typedef struct lfs_dir {
     lfs_block_t head[2];
 } lfs_dir_t;
 
+struct lfs_ctzpatch {
+    lfs_block_t index;
+    lfs_block_t block;
+};
+
+struct lfs_ctzstack {
+    lfs_foff_t index;
+    lfs_block_t block;
+};
+
 // littlefs file type
 typedef struct lfs_file {
     struct lfs_file *next;
@@ -334,18 +574,51 @@ typedef struct lfs_file {
 
     struct lfs_ctz {
         lfs_block_t head;
-        lfs_size_t size;
+        lfs_foff_t size;
+        lfs_foff_t hole;
+        lfs_off_t erased;
+        lfs_size_t journal;
+        lfs_foff_t start;
+        lfs_size_t pcount;
+#if LFS_PATCH_MAX > 0
+        struct lfs_ctzpatch patch[LFS_PATCH_MAX];
+#endif
     } ctz;
+    uint16_t jcount;
 
     uint32_t flags;
-    lfs_off_t pos;
+    lfs_foff_t pos;
     lfs_block_t block;
     lfs_off_t off;
     lfs_cache_t cache;
+    uint32_t tick;
+
+    struct lfs_ctzindex {
+        lfs_block_t *buffer;
+        lfs_size_t size;
+        lfs_size_t shift;
+    } index;
+
+#if LFS_CTZ_DEPTH > 0
+    struct lfs_ctzstack stack[LFS_CTZ_DEPTH];
+#endif
+
+    struct lfs_ctzreserve {
+        lfs_block_t *buffer;
+        lfs_size_t size;
+        lfs_size_t count;
+        bool erased;
+    } reserve;
 
     const struct lfs_file_config *cfg;
 } lfs_file_t;
 
+typedef struct lfs_index_entry {
+    lfs_block_t pair[2];
+    lfs_size_t size;
+    uint8_t key[LFS_INDEX_KEY];
+} lfs_index_entry_t;
+
 typedef struct lfs_superblock {
     uint32_t version;
     lfs_size_t block_size;
@@ -353,6 +626,7 @@ typedef struct lfs_superblock {
     lfs_size_t name_max;
     lfs_size_t file_max;
     lfs_size_t attr_max;
+    lfs_size_t patch_max;
 } lfs_superblock_t;
 
 // The littlefs filesystem type
@@ -382,10 +656,26 @@ typedef struct lfs {
         uint32_t *buffer;
     } free;
 
+    struct lfs_index {
+        lfs_size_t size;
+        lfs_size_t off;
+        lfs_index_entry_t *buffer;
+    } index;
+
+    struct lfs_pool {
+        lfs_size_t count;
+        lfs_size_t size;
+        uint32_t tick;
+        uint8_t *buffer;
+    } pool;
+
     const struct lfs_config *cfg;
+    uint32_t flags;
     lfs_size_t name_max;
-    lfs_size_t file_max;
+    lfs_foff_t file_max;
     lfs_size_t attr_max;
+    lfs_size_t patch_max;
+    lfs_size_t inline_max;
 
 #ifdef LFS_MIGRATE
     struct lfs1 *lfs1;
@@ -411,12 +701,22 @@ int lfs_format(lfs_t *lfs, const struct lfs_config *config);
 // lfs and config must be allocated while mounted. The config struct must
 // be zeroed for defaults and backwards compatibility.
 //
+// Normally mounting scans every metadata pair to rebuild the global state.
+// With LFS_M_LAZY, mount stops once the superblock is found and the scan is
+// deferred until the first write. With LFS_M_RDONLY the scan never happens
+// and any write returns LFS_ERR_ROFS. In both cases, until the scan happens,
+// a file caught in an interrupted rename may be visible at both its old and
+// new path. A current checkpoint makes the scan unnecessary.
+//
 // Returns a negative error code on failure.
 int lfs_mount(lfs_t *lfs, const struct lfs_config *config);
 
 // Unmounts a littlefs
 //
-// Does nothing besides releasing any allocated resources.
+// Releases any allocated resources. If mounted with LFS_M_CHECKPOINT, this
+// also writes out a mount checkpoint as though lfs_fs_checkpoint had been
+// called.
+//
 // Returns a negative error code on failure.
 int lfs_unmount(lfs_t *lfs);
 
@@ -436,6 +736,25 @@ int lfs_remove(lfs_t *lfs, const char *path);
 // Returns a negative error code on failure.
 int lfs_rename(lfs_t *lfs, const char *oldpath, const char *newpath);
 
+// Clone a file
+//
+// Creates a new file at dstpath with the same contents and attributes as
+// the file at srcpath. The clone shares the source's data blocks, so this
+// only costs a single metadata commit regardless of the file's size. Writes
+// to either file after cloning leave the other unchanged.
+//
+// Returns a negative error code on failure.
+int lfs_file_clone(lfs_t *lfs, const char *srcpath, const char *dstpath);
+
+// Copy a file
+//
+// Creates a new file at dstpath holding a separate copy of the data in the
+// file at srcpath. Data is copied block to block on the device without
+// passing through an intermediate buffer. User attributes are not copied.
+//
+// Returns a negative error code on failure.
+int lfs_copy(lfs_t *lfs, const char *srcpath, const char *dstpath);
+
 // Find info about a file or directory
 //
 // Fills out the info structure, based on the specified file or directory.
@@ -521,10 +840,31 @@ int lfs_file_sync(lfs_t *lfs, lfs_file_t *file);
 lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file,
         void *buffer, lfs_size_t size);
 
+// Map data in a file for reading without copying
+//
+// Finds the longest contiguous span of the file starting at the given
+// offset and points the buffer at it, letting memory-mapped block devices
+// read files in place. Spans end at block boundaries, so mapping a large file
+// takes a call for each block. The span is only valid until the file is
+// written or closed, or with pool_count set, until any file is read or
+// written. Does not change the file position.
+//
+// Blocks are mapped with the map function in the config, if this is missing
+// or the block can't be mapped, or the span is in a file's journal,
+// LFS_ERR_INVAL is returned and the data must be read with lfs_file_read.
+//
+// Returns the number of bytes mapped, 0 past the end of the file, or a
+// negative error code on failure.
+lfs_ssize_t lfs_file_map(lfs_t *lfs, lfs_file_t *file,
+        lfs_foff_t off, const void **buffer);
+
 // Write data to file
 //
 // Takes a buffer and size indicating the data to write. The file will not
 // actually be updated on the storage until either sync or close is called.
+// Appending in place to the erased tail of a file's last block first costs
+// an extra metadata commit, once per sync, to stop the block being claimed
+// as erased.
 //
 // Returns the number of bytes written, or a negative error code on failure.
 lfs_ssize_t lfs_file_write(lfs_t *lfs, lfs_file_t *file,
@@ -534,19 +874,34 @@ lfs_ssize_t lfs_file_write(lfs_t *lfs, lfs_file_t *file,
 //
 // The change in position is determined by the offset and whence flag.
 // Returns the new position of the file, or a negative error code on failure.
-lfs_soff_t lfs_file_seek(lfs_t *lfs, lfs_file_t *file,
-        lfs_soff_t off, int whence);
+lfs_sfoff_t lfs_file_seek(lfs_t *lfs, lfs_file_t *file,
+        lfs_sfoff_t off, int whence);
 
 // Truncates the size of the file to the specified size
 //
+// Extending a file past its data leaves a hole that reads back as zeros
+// without being written to storage.
+//
+// Returns a negative error code on failure.
+int lfs_file_truncate(lfs_t *lfs, lfs_file_t *file, lfs_foff_t size);
+
+// Reserves blocks for the file to grow to the specified size
+//
+// Blocks are allocated up front and held in RAM until the file uses them
+// or is closed, so later writes up to this size don't need to search for
+// free blocks or fail with LFS_ERR_NOSPC. If erase is true, the blocks are
+// also erased now instead of when they are written. Metadata updates on
+// sync may still allocate blocks.
+//
 // Returns a negative error code on failure.
-int lfs_file_truncate(lfs_t *lfs, lfs_file_t *file, lfs_off_t size);
+int lfs_file_reserve(lfs_t *lfs, lfs_file_t *file,
+        lfs_foff_t size, bool erase);
 
 // Return the position of the file
 //
 // Equivalent to lfs_file_seek(lfs, file, 0, LFS_SEEK_CUR)
 // Returns the position of the file, or a negative error code on failure.
-lfs_soff_t lfs_file_tell(lfs_t *lfs, lfs_file_t *file);
+lfs_sfoff_t lfs_file_tell(lfs_t *lfs, lfs_file_t *file);
 
 // Change the position of the file to the beginning of the file
 //
@@ -558,7 +913,7 @@ int lfs_file_rewind(lfs_t *lfs, lfs_file_t *file);
 //
 // Similar to lfs_file_seek(lfs, file, 0, LFS_SEEK_END)
 // Returns the size of the file, or a negative error code on failure.
-lfs_soff_t lfs_file_size(lfs_t *lfs, lfs_file_t *file);
+lfs_sfoff_t lfs_file_size(lfs_t *lfs, lfs_file_t *file);
 
 
 /// Directory operations ///
@@ -587,6 +942,23 @@ int lfs_dir_close(lfs_t *lfs, lfs_dir_t *dir);
 // or a negative error code on failure.
 int lfs_dir_read(lfs_t *lfs, lfs_dir_t *dir, struct lfs_info *info);
 
+// Read a batch of entries in the directory
+//
+// Fills the buffer with an array of lfs_dirent structs, with their names
+// packed at the end of the buffer. The buffer must be suitably aligned for
+// struct lfs_dirent. If attr is a custom attribute type, the attribute is
+// also read for each entry, a negative attr skips this.
+//
+// Each call reads the entries in at most one metadata pair, which requires
+// only a single scan of the pair's log, unlike lfs_dir_read which scans the
+// log for each entry. This mixes freely with lfs_dir_read.
+//
+// Returns the number of entries read, 0 at the end of directory, or a
+// negative error code on failure. Returns LFS_ERR_NOSPC if the buffer is
+// too small to hold even one entry.
+lfs_ssize_t lfs_dir_readbulk(lfs_t *lfs, lfs_dir_t *dir,
+        void *buffer, lfs_size_t size, int attr);
+
 // Change the position of the directory
 //
 // The new off must be a value previous returned from tell and specifies
@@ -603,12 +975,92 @@ int lfs_dir_seek(lfs_t *lfs, lfs_dir_t *dir, lfs_off_t off);
 // Returns the position of the directory, or a negative error code on failure.
 lfs_soff_t lfs_dir_tell(lfs_t *lfs, lfs_dir_t *dir);
 
+// Return the position of the directory as a cookie
+//
+// The cookie records the metadata pair and entry the directory is at, which
+// lets lfs_dir_seekcookie jump straight back there. The cookie can be kept
+// across opening and closing the directory, but only for the same directory.
+//
+// Returns a negative error code on failure.
+int lfs_dir_tellcookie(lfs_t *lfs, lfs_dir_t *dir,
+        struct lfs_dircookie *cookie);
+
+// Change the position of the directory to a cookie
+//
+// If the cookie's metadata pair has been committed to, compacted, or moved
+// since the cookie was made, this falls back to lfs_dir_seek with the
+// cookie's offset.
+//
+// Returns a negative error code on failure, or LFS_ERR_INVAL if the cookie
+// was made for a different directory.
+int lfs_dir_seekcookie(lfs_t *lfs, lfs_dir_t *dir,
+        const struct lfs_dircookie *cookie);
+
 // Change the position of the directory to the beginning of the directory
 //
 // Returns a negative error code on failure.
 int lfs_dir_rewind(lfs_t *lfs, lfs_dir_t *dir);
 
 
+/// Batch operations ///
+
+// Start a batch of metadata operations
+//
+// Operations added to a batch are not written until lfs_batch_commit, which
+// writes them all in a single atomic commit. Every operation in a batch must
+// land in the same metadata pair as the first, otherwise LFS_ERR_INVAL is
+// returned and the batch is left unchanged. In practice this means entries
+// in the same directory, though large directories may span several pairs.
+//
+// Paths, names, and buffers passed to batch operations must stay valid
+// until the batch is committed. No other writes may happen while a batch is
+// open. To abandon a batch, simply don't commit it.
+//
+// Returns a negative error code on failure.
+int lfs_batch_begin(lfs_t *lfs, lfs_batch_t *batch);
+
+// Add the creation of a small file to a batch
+//
+// The file is created with the given contents, which must be small enough
+// to be inlined in the metadata pair, otherwise LFS_ERR_FBIG is returned.
+// Returns LFS_ERR_EXIST if the file already exists.
+//
+// Returns a negative error code on failure.
+int lfs_batch_create(lfs_t *lfs, lfs_batch_t *batch, const char *path,
+        const void *buffer, lfs_size_t size);
+
+// Add a custom attribute update to a batch
+//
+// See lfs_setattr.
+//
+// Returns a negative error code on failure.
+int lfs_batch_setattr(lfs_t *lfs, lfs_batch_t *batch, const char *path,
+        uint8_t type, const void *buffer, lfs_size_t size);
+
+// Add the removal of a custom attribute to a batch
+//
+// See lfs_removeattr.
+//
+// Returns a negative error code on failure.
+int lfs_batch_removeattr(lfs_t *lfs, lfs_batch_t *batch, const char *path,
+        uint8_t type);
+
+// Add the removal of a file to a batch
+//
+// Removing a directory touches more than one metadata pair and can't be
+// batched, so LFS_ERR_ISDIR is returned for directories.
+//
+// Returns a negative error code on failure.
+int lfs_batch_remove(lfs_t *lfs, lfs_batch_t *batch, const char *path);
+
+// Commit a batch of metadata operations
+//
+// Either every operation in the batch takes effect or none of them do.
+//
+// Returns a negative error code on failure.
+int lfs_batch_commit(lfs_t *lfs, lfs_batch_t *batch);
+
+
 /// Filesystem-level filesystem operations
 
 // Finds the current size of the filesystem
@@ -628,6 +1080,29 @@ lfs_ssize_t lfs_fs_size(lfs_t *lfs);
 // Returns a negative error code on failure.
 int lfs_fs_traverse(lfs_t *lfs, int (*cb)(void*, lfs_block_t), void *data);
 
+// Synchronize all open files to storage
+//
+// Equivalent to calling lfs_file_sync on every open file, but files that
+// share a metadata pair are updated with a single commit, and the device
+// is only synced once at the end.
+//
+// Returns a negative error code on failure.
+int lfs_fs_sync(lfs_t *lfs);
+
+// Write a mount checkpoint to the superblock pair
+//
+// The checkpoint records the root directory, the global state, and the
+// position of the block allocator. As long as the checkpoint is current,
+// lfs_mount can use it instead of scanning every metadata pair in the
+// filesystem, making mount time independent of the number of directories.
+//
+// The checkpoint is dropped by the first write to the filesystem after it is
+// taken. Note this is only safe if every driver that writes to the filesystem
+// understands checkpoints.
+//
+// Returns a negative error code on failure.
+int lfs_fs_checkpoint(lfs_t *lfs);
+
 #ifdef LFS_MIGRATE
 // Attempts to migrate a previous version of littlefs
 //
@@ -15,11 +15,11 @@ def generate(test):
     lines = []
     for offset, line in enumerate(
             re.split('(?<=(?:.;| [{}]))\n', test.read())):
-        match = re.match('((?: *\n)*)( *)(.*)=>(.*);',
+        match = re.match('((?:(?: *|#[^\n]*)\n)*)( *)(.*)=>(.*);',
                 line, re.DOTALL | re.MULTILINE)
         if match:
             preface, tab, test, expect = match.groups()
-            lines.extend(['']*preface.count('\n'))
+            lines.extend(preface.split('\n')[:-1])
             lines.append(tab+'test_assert({test}, {expect});'.format(
                 test=test.strip(), expect=expect.strip()))
         else:
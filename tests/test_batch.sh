@@ -0,0 +1,153 @@
+#!/bin/bash
+set -eu
+export TEST_FILE=$0
+trap 'export TEST_LINE=$LINENO' DEBUG
+
+echo "=== Batch tests ==="
+rm -rf blocks
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_mkdir(&lfs, "single") => 0;
+    lfs_mkdir(&lfs, "batch") => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Batch create ---"
+scripts/test.py << TEST
+    char names[16][32];
+    lfs_batch_t batch;
+    lfs_mount(&lfs, &cfg) => 0;
+    uint64_t progs = bd.stats.prog_count;
+    for (int i = 0; i < 16; i++) {
+        sprintf(names[i], "single/file%02d", i);
+        lfs_file_open(&lfs, &file, names[i],
+                LFS_O_WRONLY | LFS_O_CREAT | LFS_O_EXCL) => 0;
+        lfs_file_write(&lfs, &file, names[i], 4) => 4;
+        lfs_file_close(&lfs, &file) => 0;
+        lfs_setattr(&lfs, names[i], 'A', names[i], 1) => 0;
+    }
+    uint64_t singleprogs = bd.stats.prog_count - progs;
+
+    progs = bd.stats.prog_count;
+    lfs_batch_begin(&lfs, &batch) => 0;
+    for (int i = 0; i < 16; i++) {
+        sprintf(names[i], "batch/file%02d", i);
+        lfs_batch_create(&lfs, &batch, names[i], names[i], 4) => 0;
+        lfs_batch_setattr(&lfs, &batch, names[i], 'A', names[i], 1) => 0;
+    }
+    lfs_stat(&lfs, "batch/file00", &info) => LFS_ERR_NOENT;
+    lfs_batch_commit(&lfs, &batch) => 0;
+    uint64_t batchprogs = bd.stats.prog_count - progs;
+    batchprogs < singleprogs => 1;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_dir_open(&lfs, &dir, "batch") => 0;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    for (int i = 0; i < 16; i++) {
+        sprintf(path, "file%02d", i);
+        lfs_dir_read(&lfs, &dir, &info) => 1;
+        strcmp(info.name, path) => 0;
+        info.type => LFS_TYPE_REG;
+        info.size => 4;
+    }
+    lfs_dir_read(&lfs, &dir, &info) => 0;
+    lfs_dir_close(&lfs, &dir) => 0;
+
+    lfs_file_open(&lfs, &file, "batch/file07", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &file, buffer, 4) => 4;
+    memcmp(buffer, "batc", 4) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_getattr(&lfs, "batch/file07", 'A', buffer, 1) => 1;
+    memcmp(buffer, "b", 1) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Batch mixed operations ---"
+scripts/test.py << TEST
+    lfs_batch_t batch;
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "batch/file09", LFS_O_RDONLY) => 0;
+
+    lfs_batch_begin(&lfs, &batch) => 0;
+    lfs_batch_remove(&lfs, &batch, "batch/file02") => 0;
+    lfs_batch_remove(&lfs, &batch, "batch/file02") => LFS_ERR_NOENT;
+    lfs_batch_create(&lfs, &batch, "batch/new", "new", 3) => 0;
+    lfs_batch_create(&lfs, &batch, "batch/new", "new", 3) => LFS_ERR_EXIST;
+    lfs_batch_create(&lfs, &batch, "batch/file03", "", 0) => LFS_ERR_EXIST;
+    lfs_batch_create(&lfs, &batch, "batch/file02", "anew", 4) => 0;
+    lfs_batch_create(&lfs, &batch, "batch/gone", "", 0) => 0;
+    lfs_batch_setattr(&lfs, &batch, "batch/gone", 'B', "b", 1) => 0;
+    lfs_batch_remove(&lfs, &batch, "batch/gone") => 0;
+    lfs_batch_removeattr(&lfs, &batch, "batch/file05", 'A') => 0;
+    lfs_batch_setattr(&lfs, &batch, "batch/new", 'B', "bb", 2) => 0;
+    lfs_batch_setattr(&lfs, &batch, "batch", 'C', "c", 1) => LFS_ERR_INVAL;
+    lfs_batch_commit(&lfs, &batch) => 0;
+
+    lfs_file_read(&lfs, &file, buffer, 4) => 4;
+    memcmp(buffer, "batc", 4) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_stat(&lfs, "batch/file02", &info) => 0;
+    info.size => 4;
+    lfs_file_open(&lfs, &file, "batch/file02", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &file, buffer, 4) => 4;
+    memcmp(buffer, "anew", 4) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_getattr(&lfs, "batch/file02", 'A', buffer, 1) => LFS_ERR_NOATTR;
+    lfs_stat(&lfs, "batch/gone", &info) => LFS_ERR_NOENT;
+    lfs_getattr(&lfs, "batch/file05", 'A', buffer, 1) => LFS_ERR_NOATTR;
+    lfs_getattr(&lfs, "batch/file06", 'A', buffer, 1) => 1;
+    lfs_getattr(&lfs, "batch/new", 'B', buffer, 2) => 2;
+    memcmp(buffer, "bb", 2) => 0;
+    lfs_getattr(&lfs, "batch", 'C', buffer, 1) => LFS_ERR_NOATTR;
+
+    // entries must stay sorted
+    lfs_dir_open(&lfs, &dir, "batch") => 0;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    strcpy((char*)buffer, "");
+    int count = 0;
+    while (lfs_dir_read(&lfs, &dir, &info) == 1) {
+        strcmp((char*)buffer, info.name) < 0 => 1;
+        strcpy((char*)buffer, info.name);
+        count += 1;
+    }
+    count => 17;
+    lfs_dir_close(&lfs, &dir) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Batch errors ---"
+scripts/test.py << TEST
+    lfs_batch_t batch;
+    lfs_mount(&lfs, &cfg) => 0;
+    uint64_t progs = bd.stats.prog_count;
+    lfs_batch_begin(&lfs, &batch) => 0;
+    lfs_batch_create(&lfs, &batch, "nodir/file", "", 0) => LFS_ERR_NOENT;
+    lfs_batch_remove(&lfs, &batch, "batch/nothing") => LFS_ERR_NOENT;
+    lfs_batch_create(&lfs, &batch, "batch/big", buffer, 1024)
+            => LFS_ERR_FBIG;
+    lfs_batch_create(&lfs, &batch, "batch/other", "", 0) => 0;
+    lfs_batch_create(&lfs, &batch, "single/other", "", 0) => LFS_ERR_INVAL;
+    lfs_batch_remove(&lfs, &batch, "/") => LFS_ERR_INVAL;
+    lfs_batch_begin(&lfs, &batch) => 0;
+    lfs_batch_remove(&lfs, &batch, "single") => LFS_ERR_ISDIR;
+    // abandoned, nothing written
+    bd.stats.prog_count => progs;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_stat(&lfs, "batch/other", &info) => LFS_ERR_NOENT;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+scripts/results.py
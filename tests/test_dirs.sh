@@ -486,4 +486,219 @@ scripts/test.py << TEST
     lfs_unmount(&lfs) => 0;
 TEST
 
+echo "--- Bulk directory read ---"
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_mkdir(&lfs, "bulk") => 0;
+    for (int i = 0; i < $LARGESIZE; i++) {
+        sprintf(path, "bulk/file%03d", i);
+        lfs_file_open(&lfs, &file, path, LFS_O_WRONLY | LFS_O_CREAT) => 0;
+        lfs_file_write(&lfs, &file, path, i % 32) => i % 32;
+        lfs_file_close(&lfs, &file) => 0;
+        if (i % 3 == 0) {
+            lfs_setattr(&lfs, path, 'A', path, 12) => 0;
+        }
+    }
+    for (int i = 0; i < $LARGESIZE; i += 5) {
+        sprintf(path, "bulk/file%03d", i);
+        lfs_remove(&lfs, path) => 0;
+        sprintf(path, "bulk/dir%03d", i);
+        lfs_mkdir(&lfs, path) => 0;
+    }
+    lfs_rename(&lfs, "bulk/file001", "bulk/file999") => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_dir_t bulkdir;
+    struct lfs_dirent ents[16];
+    lfs_dir_open(&lfs, &dir, "bulk") => 0;
+    lfs_dir_open(&lfs, &bulkdir, "bulk") => 0;
+    lfs_ssize_t count = 0;
+    lfs_ssize_t total = 0;
+    while (true) {
+        uint64_t reads = bd.stats.read_count;
+        count = lfs_dir_readbulk(&lfs, &bulkdir, ents, sizeof(ents), 'A');
+        count >= 0 => 1;
+        if (count == 0) {
+            break;
+        }
+        uint64_t bulkreads = bd.stats.read_count - reads;
+
+        reads = bd.stats.read_count;
+        for (int i = 0; i < count; i++) {
+            lfs_dir_read(&lfs, &dir, &info) => 1;
+            strcmp(ents[i].name, info.name) => 0;
+            ents[i].type => info.type;
+            if (info.type == LFS_TYPE_REG) {
+                ents[i].size => info.size;
+            }
+
+            sprintf(path, "bulk/%s", info.name);
+            lfs_ssize_t size = lfs_getattr(&lfs, path, 'A', buffer, 12);
+            if (size < 0) {
+                ents[i].attr == NULL => 1;
+                ents[i].attr_size => 0;
+            } else {
+                ents[i].attr_size => size;
+                memcmp(ents[i].attr, buffer, size) => 0;
+            }
+        }
+        uint64_t readreads = bd.stats.read_count - reads;
+        bulkreads <= readreads => 1;
+        total += count;
+        lfs_dir_tell(&lfs, &bulkdir) => total;
+    }
+    lfs_dir_read(&lfs, &dir, &info) => 0;
+    total => 2 + $LARGESIZE;
+
+    lfs_dir_rewind(&lfs, &bulkdir) => 0;
+    lfs_dir_readbulk(&lfs, &bulkdir, ents, sizeof(struct lfs_dirent), -1)
+            => LFS_ERR_NOSPC;
+    lfs_dir_readbulk(&lfs, &bulkdir, ents, 2*sizeof(struct lfs_dirent)+8, -1)
+            => 2;
+    lfs_dir_read(&lfs, &bulkdir, &info) => 1;
+    strcmp(info.name, "dir000") => 0;
+    lfs_dir_readbulk(&lfs, &bulkdir, ents, sizeof(ents), -1) > 0 => 1;
+    strcmp(ents[0].name, "dir005") => 0;
+    ents[0].attr == NULL => 1;
+    lfs_dir_close(&lfs, &bulkdir) => 0;
+    lfs_dir_close(&lfs, &dir) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Directory seek with cookies ---"
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    struct lfs_dircookie cookie;
+    lfs_dir_open(&lfs, &dir, "bulk") => 0;
+    for (int i = 0; i < 100; i++) {
+        lfs_dir_read(&lfs, &dir, &info) => 1;
+    }
+    lfs_dir_tellcookie(&lfs, &dir, &cookie) => 0;
+    lfs_soff_t pos = lfs_dir_tell(&lfs, &dir);
+    cookie.pos => pos;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    strcpy(path, info.name);
+    lfs_dir_close(&lfs, &dir) => 0;
+
+    lfs_dir_open(&lfs, &dir, "bulk") => 0;
+    uint64_t reads = bd.stats.read_count;
+    lfs_dir_seek(&lfs, &dir, pos) => 0;
+    uint64_t seekreads = bd.stats.read_count - reads;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    strcmp(info.name, path) => 0;
+    lfs_dir_close(&lfs, &dir) => 0;
+
+    lfs_dir_open(&lfs, &dir, "bulk") => 0;
+    reads = bd.stats.read_count;
+    lfs_dir_seekcookie(&lfs, &dir, &cookie) => 0;
+    uint64_t cookiereads = bd.stats.read_count - reads;
+    cookiereads < seekreads => 1;
+    lfs_dir_tell(&lfs, &dir) => pos;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    strcmp(info.name, path) => 0;
+
+    // stale cookies fall back to walking the directory
+    cookie.rev += 1;
+    lfs_dir_seekcookie(&lfs, &dir, &cookie) => 0;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    strcmp(info.name, path) => 0;
+    cookie.rev -= 1;
+
+    // so do cookies for pairs that have been committed to since
+    strcpy((char*)buffer, "bulk/");
+    strcat((char*)buffer, path);
+    lfs_remove(&lfs, (char*)buffer) => 0;
+    lfs_dir_seek(&lfs, &dir, pos) => 0;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    strcmp(info.name, path) != 0 => 1;
+    strcpy(path, info.name);
+    lfs_dir_seekcookie(&lfs, &dir, &cookie) => 0;
+    lfs_dir_tell(&lfs, &dir) => pos;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    strcmp(info.name, path) => 0;
+
+    // cookies from other directories are rejected
+    lfs_dir_t otherdir;
+    lfs_dir_open(&lfs, &otherdir, "/") => 0;
+    lfs_dir_seekcookie(&lfs, &otherdir, &cookie) => LFS_ERR_INVAL;
+    lfs_dir_close(&lfs, &otherdir) => 0;
+
+    lfs_dir_rewind(&lfs, &dir) => 0;
+    lfs_dir_tellcookie(&lfs, &dir, &cookie) => 0;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    lfs_dir_seekcookie(&lfs, &dir, &cookie) => 0;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    strcmp(info.name, ".") => 0;
+    lfs_dir_close(&lfs, &dir) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Directory index ---"
+scripts/test.py << TEST
+    struct lfs_config indexcfg = cfg;
+    indexcfg.index_size = 1024;
+    lfs_mount(&lfs, &indexcfg) => 0;
+    lfs_mkdir(&lfs, "index") => 0;
+    // out of order, so names land in the middle of the directory
+    for (int i = 0; i < 200; i++) {
+        sprintf(path, "index/file%03d", (i*37) % 200);
+        lfs_file_open(&lfs, &file, path, LFS_O_WRONLY | LFS_O_CREAT) => 0;
+        lfs_file_close(&lfs, &file) => 0;
+    }
+    lfs_unmount(&lfs) => 0;
+
+    lfs_mount(&lfs, &cfg) => 0;
+    uint64_t reads = bd.stats.read_count;
+    lfs_stat(&lfs, "index/file180", &info) => 0;
+    uint64_t walkreads = bd.stats.read_count - reads;
+
+    lfs_unmount(&lfs) => 0;
+
+    lfs_mount(&lfs, &indexcfg) => 0;
+    lfs_stat(&lfs, "index/file199", &info) => 0;
+    reads = bd.stats.read_count;
+    lfs_stat(&lfs, "index/file180", &info) => 0;
+    uint64_t indexreads = bd.stats.read_count - reads;
+    indexreads < walkreads => 1;
+
+    for (int i = 0; i < 200; i++) {
+        sprintf(path, "index/file%03d", i);
+        lfs_stat(&lfs, path, &info) => 0;
+    }
+    lfs_stat(&lfs, "index/file200", &info) => LFS_ERR_NOENT;
+    lfs_stat(&lfs, "index/file0995", &info) => LFS_ERR_NOENT;
+
+    for (int i = 0; i < 200; i += 2) {
+        sprintf(path, "index/file%03d", i);
+        lfs_remove(&lfs, path) => 0;
+    }
+    for (int i = 0; i < 200; i += 4) {
+        sprintf(path, "index/file%03db", i);
+        lfs_mkdir(&lfs, path) => 0;
+    }
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_dir_open(&lfs, &dir, "index") => 0;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    for (int i = 0; i < 200; i++) {
+        if (i % 4 == 0) {
+            sprintf(path, "file%03db", i);
+        } else if (i % 2 == 1) {
+            sprintf(path, "file%03d", i);
+        } else {
+            continue;
+        }
+        lfs_dir_read(&lfs, &dir, &info) => 1;
+        strcmp(info.name, path) => 0;
+    }
+    lfs_dir_read(&lfs, &dir, &info) => 0;
+    lfs_dir_close(&lfs, &dir) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
 scripts/results.py
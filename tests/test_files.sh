@@ -218,4 +218,894 @@ scripts/test.py << TEST
     lfs_unmount(&lfs) => 0;
 TEST
 
+echo "--- Streaming write test ---"
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "streaming",
+            LFS_O_WRONLY | LFS_O_CREAT | LFS_O_EXCL) => 0;
+    for (int j = 0; j < 512; j++) {
+        buffer[j] = j % 251;
+    }
+    // two writes are enough to outgrow any inline file
+    lfs_file_write(&lfs, &file, buffer, 512) => 512;
+    lfs_file_write(&lfs, &file, buffer, 512) => 512;
+    // appending fresh blocks should only read to verify progs, unless
+    // we have no stack to remember the pointers we write
+    uint64_t reads = bd.stats.read_count;
+    uint64_t progs = bd.stats.prog_count;
+    for (int i = 2; i < 64; i++) {
+        lfs_file_write(&lfs, &file, buffer, 512) => 512;
+    }
+#if LFS_CTZ_DEPTH > 0
+    bd.stats.read_count - reads => bd.stats.prog_count - progs;
+#else
+    (void)reads;
+    (void)progs;
+#endif
+    lfs_file_close(&lfs, &file) => 0;
+
+    // appending to an existing file only reads back the pointers once
+    lfs_file_open(&lfs, &file, "streaming",
+            LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    for (int i = 0; i < 32; i++) {
+        lfs_file_write(&lfs, &file, buffer, 512) => 512;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    lfs_file_open(&lfs, &file, "streaming", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 96*512;
+    for (int i = 0; i < 96; i++) {
+        uint8_t rbuffer[512];
+        lfs_file_read(&lfs, &file, rbuffer, 512) => 512;
+        memcmp(rbuffer, buffer, 512) => 0;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Append in place test ---"
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    // a file that ends on a prog boundary about halfway through a block
+    lfs_size_t size = LFS_PROG_SIZE * ((LFS_BLOCK_SIZE/2) / LFS_PROG_SIZE + 1);
+    memset(buffer, 'a', sizeof(buffer));
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    for (lfs_size_t i = 0; i < size; i += sizeof(buffer)) {
+        lfs_size_t chunk = (size-i < sizeof(buffer)) ? size-i : sizeof(buffer);
+        lfs_file_write(&lfs, &file, buffer, chunk) => chunk;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+#if LFS_PROG_SIZE <= LFS_BLOCK_SIZE/16
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_RDONLY) => 0;
+    lfs_block_t head = file.ctz.head;
+    lfs_file_close(&lfs, &file) => 0;
+#endif
+
+    // small appends that stay on prog boundaries don't need new blocks
+    static uint8_t pbuffer[LFS_PROG_SIZE];
+    for (int i = 0; i < 4; i++) {
+        memset(pbuffer, 'b'+i, LFS_PROG_SIZE);
+        lfs_file_open(&lfs, &file, "aligned",
+                LFS_O_WRONLY | LFS_O_APPEND) => 0;
+        lfs_file_write(&lfs, &file, pbuffer, LFS_PROG_SIZE) => LFS_PROG_SIZE;
+        lfs_file_close(&lfs, &file) => 0;
+    }
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_RDONLY) => 0;
+#if LFS_PROG_SIZE <= LFS_BLOCK_SIZE/16
+    file.ctz.head => head;
+#endif
+    lfs_file_size(&lfs, &file) => size + 4*LFS_PROG_SIZE;
+    lfs_file_seek(&lfs, &file, size, LFS_SEEK_SET) => size;
+    for (int i = 0; i < 4*LFS_PROG_SIZE; i++) {
+        uint8_t c;
+        lfs_file_read(&lfs, &file, &c, 1) => 1;
+        c => 'b' + i/LFS_PROG_SIZE;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    // lose power after programming in place but before syncing, seeking
+    // flushes our data to the block without committing it
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_write(&lfs, &file, "x", 1) => 1;
+    lfs_file_seek(&lfs, &file, 0, LFS_SEEK_SET) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_size_t size = LFS_PROG_SIZE * ((LFS_BLOCK_SIZE/2) / LFS_PROG_SIZE + 1);
+    size += 4*LFS_PROG_SIZE;
+
+    // the block can't be claimed as erased anymore
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => size;
+    file.ctz.erased => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_write(&lfs, &file, "y", 1) => 1;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => size+1;
+    lfs_file_seek(&lfs, &file, -2, LFS_SEEK_END) => size-1;
+    lfs_file_read(&lfs, &file, buffer, 2) => 2;
+    buffer[0] => 'b'+3;
+    buffer[1] => 'y';
+    lfs_file_close(&lfs, &file) => 0;
+
+    // writing into the file gives up the erased tail
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_RDWR) => 0;
+    lfs_file_write(&lfs, &file, "c", 1) => 1;
+    lfs_file_truncate(&lfs, &file, size) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "aligned",
+            LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_write(&lfs, &file, "d", 1) => 1;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => size+1;
+    lfs_file_read(&lfs, &file, buffer, 2) => 2;
+    memcmp(buffer, "ca", 2) => 0;
+    lfs_file_seek(&lfs, &file, -2, LFS_SEEK_END) => size-1;
+    lfs_file_read(&lfs, &file, buffer, 2) => 2;
+    buffer[0] => 'b'+3;
+    buffer[1] => 'd';
+    lfs_file_close(&lfs, &file) => 0;
+
+    // appends in place can run on past the end of the block
+    memset(buffer, 'e', sizeof(buffer));
+    lfs_file_open(&lfs, &file, "span", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    for (lfs_size_t i = 0; i < 17*LFS_PROG_SIZE; i += sizeof(buffer)) {
+        lfs_size_t chunk = (17*LFS_PROG_SIZE-i < sizeof(buffer))
+                ? 17*LFS_PROG_SIZE-i : sizeof(buffer);
+        lfs_file_write(&lfs, &file, buffer, chunk) => chunk;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "span", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    for (int i = 0; i < 2*LFS_BLOCK_SIZE; i++) {
+        lfs_file_write(&lfs, &file, "f", 1) => 1;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "span", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 17*LFS_PROG_SIZE + 2*LFS_BLOCK_SIZE;
+    lfs_file_seek(&lfs, &file, 17*LFS_PROG_SIZE,
+            LFS_SEEK_SET) => 17*LFS_PROG_SIZE;
+    for (int i = 0; i < 2*LFS_BLOCK_SIZE; i++) {
+        uint8_t c;
+        lfs_file_read(&lfs, &file, &c, 1) => 1;
+        c => 'f';
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Append in place commit test ---"
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_size_t size = LFS_PROG_SIZE * ((LFS_BLOCK_SIZE/2) / LFS_PROG_SIZE + 1);
+    memset(buffer, 'a', sizeof(buffer));
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    for (lfs_size_t i = 0; i < size; i += sizeof(buffer)) {
+        lfs_size_t chunk = (size-i < sizeof(buffer)) ? size-i : sizeof(buffer);
+        lfs_file_write(&lfs, &file, buffer, chunk) => chunk;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+#if LFS_PROG_SIZE <= LFS_BLOCK_SIZE/16
+    // an append session in place costs two commits, the first clears the
+    // erased offset before any data is programmed, only once per session
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    uint64_t progs = bd.stats.prog_count;
+    lfs_file_write(&lfs, &file, "b", 1) => 1;
+    uint64_t unerase = bd.stats.prog_count - progs;
+    (unerase > 0) => true;
+    progs = bd.stats.prog_count;
+    lfs_file_write(&lfs, &file, "c", 1) => 1;
+    bd.stats.prog_count - progs => 0;
+
+    // the sync then programs our data and commits the new size
+    progs = bd.stats.prog_count;
+    lfs_file_close(&lfs, &file) => 0;
+    (bd.stats.prog_count - progs >= LFS_PROG_SIZE + unerase) => true;
+
+    lfs_file_open(&lfs, &file, "aligned", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => size+2;
+    lfs_file_seek(&lfs, &file, size, LFS_SEEK_SET) => size;
+    lfs_file_read(&lfs, &file, buffer, 2) => 2;
+    memcmp(buffer, "bc", 2) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+#endif
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Append journal test ---"
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    // files too big to be inline, with an odd size so appends don't
+    // end on prog boundaries and can't be programmed in place
+    memset(buffer, 'a', 1023);
+    lfs_file_open(&lfs, &file, "plain", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, buffer, 1023) => 1023;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "journal", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, buffer, 1023) => 1023;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // small synced appends land in the metadata log instead of copying
+    // the last block, which programs fewer bytes
+    uint64_t progs = bd.stats.prog_count;
+    lfs_file_open(&lfs, &file, "plain", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    for (int i = 0; i < 20; i++) {
+        memset(buffer, 'b'+i, 10);
+        lfs_file_write(&lfs, &file, buffer, 10) => 10;
+        lfs_file_sync(&lfs, &file) => 0;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    uint64_t plain = bd.stats.prog_count - progs;
+
+    struct lfs_file_config jcfg = {.journal_size = 64};
+    progs = bd.stats.prog_count;
+    lfs_file_opencfg(&lfs, &file, "journal",
+            LFS_O_WRONLY | LFS_O_APPEND, &jcfg) => 0;
+    for (int i = 0; i < 20; i++) {
+        memset(buffer, 'b'+i, 10);
+        lfs_file_write(&lfs, &file, buffer, 10) => 10;
+        lfs_file_sync(&lfs, &file) => 0;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    uint64_t journaled = bd.stats.prog_count - progs;
+#if LFS_PROG_SIZE > 1
+    journaled < plain => 1;
+#else
+    (void)plain;
+    (void)journaled;
+#endif
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_rename(&lfs, "journal", "renamed") => 0;
+    lfs_stat(&lfs, "renamed", &info) => 0;
+    info.size => 1223;
+    lfs_file_open(&lfs, &file, "renamed", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 1223;
+    lfs_file_read(&lfs, &file, buffer, 1023) => 1023;
+    for (int i = 0; i < 20; i++) {
+        uint8_t rbuffer[10];
+        memset(buffer, 'b'+i, 10);
+        lfs_file_read(&lfs, &file, rbuffer, 10) => 10;
+        memcmp(rbuffer, buffer, 10) => 0;
+    }
+    lfs_file_read(&lfs, &file, buffer, 10) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // writing elsewhere merges the journal into the file
+    struct lfs_file_config jcfg = {.journal_size = 64};
+    lfs_file_opencfg(&lfs, &file, "renamed", LFS_O_RDWR, &jcfg) => 0;
+    lfs_file_seek(&lfs, &file, 0, LFS_SEEK_END) => 1223;
+    lfs_file_write(&lfs, &file, "cc", 2) => 2;
+    lfs_file_seek(&lfs, &file, 1218, LFS_SEEK_SET) => 1218;
+    lfs_file_read(&lfs, &file, buffer, 7) => 7;
+    memcmp(buffer, "uuuuucc", 7) => 0;
+    lfs_file_seek(&lfs, &file, 0, LFS_SEEK_SET) => 0;
+    lfs_file_write(&lfs, &file, "d", 1) => 1;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "renamed", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 1225;
+    lfs_file_read(&lfs, &file, buffer, 2) => 2;
+    memcmp(buffer, "da", 2) => 0;
+    lfs_file_seek(&lfs, &file, 1218, LFS_SEEK_SET) => 1218;
+    lfs_file_read(&lfs, &file, buffer, 7) => 7;
+    memcmp(buffer, "uuuuucc", 7) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    struct lfs_file_config jcfg = {.journal_size = 64};
+    memset(buffer, 'a', 1023);
+    lfs_file_opencfg(&lfs, &file, "merge", LFS_O_WRONLY | LFS_O_CREAT,
+            &jcfg) => 0;
+    lfs_file_write(&lfs, &file, buffer, 1023) => 1023;
+    lfs_file_sync(&lfs, &file) => 0;
+    lfs_file_write(&lfs, &file, "bbbbbbbbbb", 10) => 10;
+    lfs_file_sync(&lfs, &file) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // fill up the filesystem, keeping the filler open so blocks it was
+    // writing to stay in use
+    lfs_file_t filler;
+    lfs_file_open(&lfs, &filler, "filler", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    while (true) {
+        lfs_ssize_t res = lfs_file_write(&lfs, &filler, buffer, 1023);
+        if (res < 0) {
+            res => LFS_ERR_NOSPC;
+            break;
+        }
+        int err = lfs_file_sync(&lfs, &filler);
+        if (err) {
+            err => LFS_ERR_NOSPC;
+            break;
+        }
+    }
+
+    // a failed merge leaves the journal as it was
+    lfs_file_opencfg(&lfs, &file, "merge", LFS_O_RDWR, &jcfg) => 0;
+    lfs_file_write(&lfs, &file, "c", 1) => LFS_ERR_NOSPC;
+    lfs_file_size(&lfs, &file) => 1033;
+    lfs_file_seek(&lfs, &file, 1020, LFS_SEEK_SET) => 1020;
+    lfs_file_read(&lfs, &file, buffer, 13) => 13;
+    memcmp(buffer, "aaabbbbbbbbbb", 13) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_close(&lfs, &filler);
+
+    lfs_remove(&lfs, "filler") => 0;
+    lfs_file_open(&lfs, &file, "merge", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 1033;
+    lfs_file_seek(&lfs, &file, 1020, LFS_SEEK_SET) => 1020;
+    lfs_file_read(&lfs, &file, buffer, 13) => 13;
+    memcmp(buffer, "aaabbbbbbbbbb", 13) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Large inline file test ---"
+scripts/test.py << TEST
+    struct lfs_config icfg = cfg;
+    icfg.block_size = cfg.cache_size*((4096+cfg.cache_size-1)/cfg.cache_size);
+    icfg.block_count = 128;
+    icfg.inline_max = 2048;
+    lfs_format(&lfs, &icfg) => 0;
+    lfs_mount(&lfs, &icfg) => 0;
+    uint8_t wbuffer[2049];
+    for (int i = 0; i < 2049; i++) {
+        wbuffer[i] = 'a' + i % 26;
+    }
+    lfs_file_open(&lfs, &file, "inline", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, wbuffer, 1500) => 1500;
+    lfs_file_sync(&lfs, &file) => 0;
+    (file.flags & LFS_F_INLINE) => LFS_F_INLINE;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    struct lfs_config icfg = cfg;
+    icfg.block_size = cfg.cache_size*((4096+cfg.cache_size-1)/cfg.cache_size);
+    icfg.block_count = 128;
+    icfg.inline_max = 2048;
+    lfs_mount(&lfs, &icfg) => 0;
+    uint8_t wbuffer[2049];
+    uint8_t rbuffer[2049];
+    for (int i = 0; i < 2049; i++) {
+        wbuffer[i] = 'a' + i % 26;
+    }
+    lfs_rename(&lfs, "inline", "renamed") => 0;
+    lfs_stat(&lfs, "renamed", &info) => 0;
+    info.size => 1500;
+    lfs_file_open(&lfs, &file, "renamed", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &file, rbuffer, 2049) => 1500;
+    memcmp(rbuffer, wbuffer, 1500) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // shrinking to a single full tag drops the rest
+    lfs_file_open(&lfs, &file, "renamed", LFS_O_RDWR) => 0;
+    lfs_file_truncate(&lfs, &file, 1022) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_stat(&lfs, "renamed", &info) => 0;
+    info.size => 1022;
+
+    // up to inline_max stays inline
+    lfs_file_open(&lfs, &file, "renamed", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_write(&lfs, &file, &wbuffer[1022], 2048-1022) => 2048-1022;
+    lfs_file_sync(&lfs, &file) => 0;
+    (file.flags & LFS_F_INLINE) => LFS_F_INLINE;
+    lfs_file_close(&lfs, &file) => 0;
+    struct lfs_dirent ents[8];
+    lfs_dir_open(&lfs, &dir, "/") => 0;
+    lfs_ssize_t n;
+    while ((n = lfs_dir_readbulk(&lfs, &dir, ents, sizeof(ents), -1)) > 0 &&
+            strcmp(ents[n-1].name, "renamed") != 0) {
+    }
+    (n > 0) => true;
+    ents[n-1].size => 2048;
+    lfs_dir_close(&lfs, &dir) => 0;
+    lfs_file_open(&lfs, &file, "renamed", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &file, rbuffer, 2049) => 2048;
+    memcmp(rbuffer, wbuffer, 2048) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // one more byte moves it out of the metadata pair
+    lfs_file_open(&lfs, &file, "renamed", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_write(&lfs, &file, &wbuffer[2048], 1) => 1;
+    lfs_file_sync(&lfs, &file) => 0;
+    (file.flags & LFS_F_INLINE) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    struct lfs_config icfg = cfg;
+    icfg.block_size = cfg.cache_size*((4096+cfg.cache_size-1)/cfg.cache_size);
+    icfg.block_count = 128;
+    icfg.inline_max = 2048;
+    lfs_mount(&lfs, &icfg) => 0;
+    uint8_t wbuffer[2049];
+    uint8_t rbuffer[2049];
+    for (int i = 0; i < 2049; i++) {
+        wbuffer[i] = 'a' + i % 26;
+    }
+    lfs_dir_open(&lfs, &dir, "/") => 0;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    lfs_dir_read(&lfs, &dir, &info) => 1;
+    strcmp(info.name, "renamed") => 0;
+    info.size => 2049;
+    lfs_dir_close(&lfs, &dir) => 0;
+    lfs_file_open(&lfs, &file, "renamed", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &file, rbuffer, 2049) => 2049;
+    memcmp(rbuffer, wbuffer, 2049) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    // a file ending on a chunk boundary must not pick up chunks left
+    // behind by a mount with a larger inline_max
+    struct lfs_config icfg = cfg;
+    icfg.block_size = cfg.cache_size*((4096+cfg.cache_size-1)/cfg.cache_size);
+    icfg.block_count = 128;
+    icfg.inline_max = 2048;
+    lfs_mount(&lfs, &icfg) => 0;
+    uint8_t wbuffer[2049];
+    uint8_t rbuffer[2049];
+    for (int i = 0; i < 2049; i++) {
+        wbuffer[i] = 'a' + i % 26;
+    }
+    lfs_file_open(&lfs, &file, "edge", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, wbuffer, 2048) => 2048;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+
+    icfg.inline_max = 2*1022;
+    lfs_mount(&lfs, &icfg) => 0;
+    lfs_file_open(&lfs, &file, "edge", LFS_O_WRONLY | LFS_O_TRUNC) => 0;
+    lfs_file_write(&lfs, &file, wbuffer, 2*1022) => 2*1022;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_stat(&lfs, "edge", &info) => 0;
+    info.size => 2*1022;
+    lfs_file_open(&lfs, &file, "edge", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &file, rbuffer, 2049) => 2*1022;
+    memcmp(rbuffer, wbuffer, 2*1022) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Mapped read test ---"
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "small", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, "hello", 5) => 5;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "large", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    for (int i = 0; i < 4*LFS_BLOCK_SIZE; i++) {
+        uint8_t c = 'a' + i % 26;
+        lfs_file_write(&lfs, &file, &c, 1) => 1;
+    }
+    lfs_file_truncate(&lfs, &file, 5*LFS_BLOCK_SIZE) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    struct lfs_config mapcfg = cfg;
+    mapcfg.map = test_map;
+    lfs_mount(&lfs, &mapcfg) => 0;
+    const void *mapped;
+    lfs_file_open(&lfs, &file, "small", LFS_O_RDONLY) => 0;
+    lfs_file_map(&lfs, &file, 1, &mapped) => 4;
+    memcmp(mapped, "ello", 4) => 0;
+    lfs_file_map(&lfs, &file, 5, &mapped) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // spans end at block boundaries and skip the skip-list pointers
+    lfs_file_open(&lfs, &file, "large", LFS_O_RDONLY) => 0;
+    lfs_foff_t off = 0;
+    while (off < 4*LFS_BLOCK_SIZE) {
+        lfs_ssize_t size = lfs_file_map(&lfs, &file, off, &mapped);
+        size > 0 => 1;
+        size <= LFS_BLOCK_SIZE => 1;
+        for (lfs_ssize_t i = 0; i < size; i++) {
+            ((const uint8_t*)mapped)[i] => 'a' + (off+i) % 26;
+        }
+        off += size;
+    }
+    off => 4*LFS_BLOCK_SIZE;
+    lfs_file_map(&lfs, &file, off, &mapped) => 64;
+    ((const uint8_t*)mapped)[0] => 0;
+    lfs_file_map(&lfs, &file, 5*LFS_BLOCK_SIZE, &mapped) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "large", LFS_O_RDONLY) => 0;
+    lfs_file_map(&lfs, &file, 0, &mapped) => LFS_ERR_INVAL;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- File clone test ---"
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_mkdir(&lfs, "dir") => 0;
+    lfs_file_open(&lfs, &file, "small", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, "hello", 5) => 5;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "large", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    for (int i = 0; i < 4*LFS_BLOCK_SIZE+100; i++) {
+        uint8_t c = 'a' + i % 26;
+        lfs_file_write(&lfs, &file, &c, 1) => 1;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    // cloning only costs metadata commits, far less than copying the data
+    uint64_t progs = bd.stats.prog_count;
+    lfs_file_clone(&lfs, "large", "dir/large") => 0;
+    lfs_file_clone(&lfs, "large", "clone") => 0;
+    lfs_file_clone(&lfs, "small", "dir/small") => 0;
+    bd.stats.prog_count - progs < 2*(4*LFS_BLOCK_SIZE+100) => 1;
+
+    lfs_file_clone(&lfs, "large", "small") => LFS_ERR_EXIST;
+    lfs_file_clone(&lfs, "dir", "dir2") => LFS_ERR_ISDIR;
+    lfs_file_clone(&lfs, "missing", "dir2") => LFS_ERR_NOENT;
+    lfs_file_clone(&lfs, "large", "missing/large") => LFS_ERR_NOENT;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_stat(&lfs, "dir/small", &info) => 0;
+    info.size => 5;
+    lfs_file_open(&lfs, &file, "dir/small", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &file, buffer, 5) => 5;
+    memcmp(buffer, "hello", 5) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // appending to either file leaves the others alone
+    lfs_file_open(&lfs, &file, "large", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_write(&lfs, &file, "1111", 4) => 4;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "clone", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_write(&lfs, &file, "2222", 4) => 4;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "dir/large", LFS_O_WRONLY) => 0;
+    lfs_file_write(&lfs, &file, "3333", 4) => 4;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_remove(&lfs, "small") => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    const char *names[3] = {"large", "clone", "dir/large"};
+    for (int n = 0; n < 3; n++) {
+        lfs_file_open(&lfs, &file, names[n], LFS_O_RDONLY) => 0;
+        lfs_file_size(&lfs, &file) => 4*LFS_BLOCK_SIZE+100 + (n < 2 ? 4 : 0);
+        for (int i = 0; i < 4*LFS_BLOCK_SIZE+100; i++) {
+            uint8_t c;
+            lfs_file_read(&lfs, &file, &c, 1) => 1;
+            if (n == 2 && i < 4) {
+                c => '3';
+            } else {
+                c => 'a' + i % 26;
+            }
+        }
+        if (n < 2) {
+            lfs_file_read(&lfs, &file, buffer, 4) => 4;
+            memcmp(buffer, n == 0 ? "1111" : "2222", 4) => 0;
+        }
+        lfs_file_close(&lfs, &file) => 0;
+    }
+    lfs_stat(&lfs, "small", &info) => LFS_ERR_NOENT;
+    lfs_stat(&lfs, "dir/small", &info) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- File copy test ---"
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_mkdir(&lfs, "dir") => 0;
+    lfs_file_open(&lfs, &file, "small", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, "hello", 5) => 5;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "large", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    for (int i = 0; i < 8*LFS_BLOCK_SIZE+100; i++) {
+        uint8_t c = 'a' + i % 26;
+        lfs_file_write(&lfs, &file, &c, 1) => 1;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    // journaled appends and holes are copied too
+    struct lfs_file_config jcfg = {.journal_size = 64};
+    lfs_file_opencfg(&lfs, &file, "large", LFS_O_WRONLY | LFS_O_APPEND,
+            &jcfg) => 0;
+    lfs_file_write(&lfs, &file, "journal", 7) => 7;
+    lfs_file_sync(&lfs, &file) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "holey", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, "hole", 4) => 4;
+    lfs_file_truncate(&lfs, &file, 2*LFS_BLOCK_SIZE) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    lfs_ssize_t blocks = lfs_fs_size(&lfs);
+    lfs_copy(&lfs, "large", "dir/large") => 0;
+    lfs_fs_size(&lfs) - blocks => 9;
+
+    lfs_copy(&lfs, "small", "dir/small") => 0;
+    lfs_copy(&lfs, "holey", "dir/holey") => 0;
+    lfs_copy(&lfs, "large", "small") => LFS_ERR_EXIST;
+    lfs_copy(&lfs, "dir", "dir2") => LFS_ERR_ISDIR;
+    lfs_copy(&lfs, "missing", "dir2") => LFS_ERR_NOENT;
+    lfs_stat(&lfs, "dir2", &info) => LFS_ERR_NOENT;
+    lfs_remove(&lfs, "large") => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "dir/small", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &file, buffer, sizeof(buffer)) => 5;
+    memcmp(buffer, "hello", 5) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    lfs_file_open(&lfs, &file, "dir/holey", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 2*LFS_BLOCK_SIZE;
+    lfs_file_read(&lfs, &file, buffer, 4) => 4;
+    memcmp(buffer, "hole", 4) => 0;
+    lfs_file_read(&lfs, &file, buffer, 4) => 4;
+    memcmp(buffer, "\0\0\0\0", 4) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    lfs_file_open(&lfs, &file, "dir/large", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 8*LFS_BLOCK_SIZE+107;
+    for (int i = 0; i < 8*LFS_BLOCK_SIZE+100; i++) {
+        uint8_t c;
+        lfs_file_read(&lfs, &file, &c, 1) => 1;
+        c => 'a' + i % 26;
+    }
+    lfs_file_read(&lfs, &file, buffer, sizeof(buffer)) => 7;
+    memcmp(buffer, "journal", 7) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // the copy can keep growing
+    lfs_file_open(&lfs, &file, "dir/large", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_write(&lfs, &file, "!", 1) => 1;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_stat(&lfs, "dir/large", &info) => 0;
+    info.size => 8*LFS_BLOCK_SIZE+108;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Block reservation test ---"
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "reserved", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_reserve(&lfs, &file, 8*LFS_BLOCK_SIZE, true) => 0;
+
+    // streaming into erased reserved blocks doesn't erase anything
+    uint64_t erases = bd.stats.erase_count;
+    for (int i = 0; i < 8*LFS_BLOCK_SIZE; i++) {
+        uint8_t c = 'a' + i % 26;
+        lfs_file_write(&lfs, &file, &c, 1) => 1;
+    }
+    bd.stats.erase_count => erases;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // a static buffer limits the reservation
+    lfs_block_t rbuffer[2];
+    struct lfs_file_config rcfg = {
+        .reserve_buffer = rbuffer,
+        .reserve_size = sizeof(rbuffer),
+    };
+    lfs_file_opencfg(&lfs, &file, "static",
+            LFS_O_WRONLY | LFS_O_CREAT, &rcfg) => 0;
+    lfs_file_reserve(&lfs, &file, LFS_BLOCK_SIZE, false) => 0;
+    lfs_file_reserve(&lfs, &file, 4*LFS_BLOCK_SIZE, false) => LFS_ERR_NOMEM;
+    lfs_file_write(&lfs, &file, "hello", 5) => 5;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "reserved", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 8*LFS_BLOCK_SIZE;
+    for (int i = 0; i < 8*LFS_BLOCK_SIZE; i++) {
+        uint8_t c;
+        lfs_file_read(&lfs, &file, &c, 1) => 1;
+        c => 'a' + i % 26;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "static", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &file, buffer, sizeof(buffer)) => 5;
+    memcmp(buffer, "hello", 5) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    struct lfs_config rcfg = cfg;
+    rcfg.block_count = 32;
+    lfs_format(&lfs, &rcfg) => 0;
+    lfs_mount(&lfs, &rcfg) => 0;
+    lfs_file_open(&lfs, &file, "reserved", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_reserve(&lfs, &file, 20*LFS_BLOCK_SIZE, false) => 0;
+
+    // other files can't take reserved blocks
+    lfs_file_t file2;
+    lfs_file_open(&lfs, &file2, "other", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_ssize_t res = 0;
+    for (int i = 0; i < 12*LFS_BLOCK_SIZE && res >= 0; i++) {
+        res = lfs_file_write(&lfs, &file2, "x", 1);
+    }
+    res => LFS_ERR_NOSPC;
+    lfs_file_close(&lfs, &file2);
+    lfs_remove(&lfs, "other") => 0;
+
+    for (int i = 0; i < 20*LFS_BLOCK_SIZE; i++) {
+        uint8_t c = 'a' + i % 26;
+        lfs_file_write(&lfs, &file, &c, 1) => 1;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    // unused reservations are released on close
+    lfs_file_open(&lfs, &file, "reserved", LFS_O_WRONLY) => 0;
+    lfs_file_reserve(&lfs, &file, 26*LFS_BLOCK_SIZE, false) => 0;
+    lfs_file_reserve(&lfs, &file, 40*LFS_BLOCK_SIZE, false) => LFS_ERR_NOSPC;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "other", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    for (int i = 0; i < 4*LFS_BLOCK_SIZE; i++) {
+        lfs_file_write(&lfs, &file, "x", 1) => 1;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Ring file test ---"
+scripts/test.py << TEST
+    struct lfs_config rcfg = cfg;
+    rcfg.block_count = 32;
+    lfs_format(&lfs, &rcfg) => 0;
+    lfs_mount(&lfs, &rcfg) => 0;
+
+    // far more data than fits on disk, the ring keeps reusing blocks
+    struct lfs_file_config ringcfg = {.ring_size = 4*LFS_BLOCK_SIZE};
+    lfs_file_opencfg(&lfs, &file, "ring",
+            LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND, &ringcfg) => 0;
+    for (int i = 0; i < 100*LFS_BLOCK_SIZE; i += 64) {
+        for (int j = 0; j < 64; j++) {
+            buffer[j] = 'a' + (i+j) % 26;
+        }
+        lfs_file_write(&lfs, &file, buffer, 64) => 64;
+        if ((i/64) % 8 == 7) {
+            lfs_file_sync(&lfs, &file) => 0;
+            lfs_file_size(&lfs, &file) <= 4*LFS_BLOCK_SIZE => 1;
+        }
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_fs_size(&lfs) < 10 => 1;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    struct lfs_config rcfg = cfg;
+    rcfg.block_count = 32;
+    lfs_mount(&lfs, &rcfg) => 0;
+    lfs_stat(&lfs, "ring", &info) => 0;
+    info.size => 4*LFS_BLOCK_SIZE;
+
+    // reads start at the oldest data still in the ring
+    lfs_file_open(&lfs, &file, "ring", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 4*LFS_BLOCK_SIZE;
+    lfs_foff_t base = 96*LFS_BLOCK_SIZE;
+    for (int i = 0; i < 4*LFS_BLOCK_SIZE; i++) {
+        uint8_t c;
+        lfs_file_read(&lfs, &file, &c, 1) => 1;
+        c => 'a' + (base+i) % 26;
+    }
+    lfs_file_read(&lfs, &file, buffer, 1) => 0;
+    lfs_file_seek(&lfs, &file, 100, LFS_SEEK_SET) => 100;
+    lfs_file_tell(&lfs, &file) => 100;
+    lfs_file_read(&lfs, &file, buffer, 1) => 1;
+    buffer[0] => 'a' + (base+100) % 26;
+    lfs_file_seek(&lfs, &file, -1, LFS_SEEK_SET) => LFS_ERR_INVAL;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // copies only hold what's left
+    lfs_copy(&lfs, "ring", "copy") => 0;
+    lfs_stat(&lfs, "copy", &info) => 0;
+    info.size => 4*LFS_BLOCK_SIZE;
+    lfs_file_open(&lfs, &file, "copy", LFS_O_RDONLY) => 0;
+    for (int i = 0; i < 4*LFS_BLOCK_SIZE; i++) {
+        uint8_t c;
+        lfs_file_read(&lfs, &file, &c, 1) => 1;
+        c => 'a' + (base+i) % 26;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_remove(&lfs, "copy") => 0;
+
+    // rewriting the first bytes and truncating still work
+    lfs_file_open(&lfs, &file, "ring", LFS_O_RDWR) => 0;
+    lfs_file_write(&lfs, &file, "hello", 5) => 5;
+    lfs_file_truncate(&lfs, &file, 2*LFS_BLOCK_SIZE) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    struct lfs_config rcfg = cfg;
+    rcfg.block_count = 32;
+    lfs_mount(&lfs, &rcfg) => 0;
+    lfs_file_open(&lfs, &file, "ring", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 2*LFS_BLOCK_SIZE;
+    lfs_file_read(&lfs, &file, buffer, 5) => 5;
+    memcmp(buffer, "hello", 5) => 0;
+    lfs_foff_t base = 96*LFS_BLOCK_SIZE;
+    for (int i = 5; i < 2*LFS_BLOCK_SIZE; i++) {
+        uint8_t c;
+        lfs_file_read(&lfs, &file, &c, 1) => 1;
+        c => 'a' + (base+i) % 26;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    // files without a ring keep everything
+    lfs_file_open(&lfs, &file, "ring", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    for (int i = 0; i < 4*LFS_BLOCK_SIZE; i++) {
+        lfs_file_write(&lfs, &file, "x", 1) => 1;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_stat(&lfs, "ring", &info) => 0;
+    info.size => 6*LFS_BLOCK_SIZE;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    struct lfs_config rcfg = cfg;
+    rcfg.block_count = 32;
+    rcfg.file_max = 8*LFS_BLOCK_SIZE;
+    lfs_format(&lfs, &rcfg) => 0;
+    lfs_mount(&lfs, &rcfg) => 0;
+
+    // only the data left in a ring counts against file_max
+    struct lfs_file_config ringcfg = {.ring_size = 4*LFS_BLOCK_SIZE};
+    lfs_file_opencfg(&lfs, &file, "ring",
+            LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND, &ringcfg) => 0;
+    for (int i = 0; i < 64*LFS_BLOCK_SIZE; i += 64) {
+        for (int j = 0; j < 64; j++) {
+            buffer[j] = 'a' + (i+j) % 26;
+        }
+        lfs_file_write(&lfs, &file, buffer, 64) => 64;
+        if ((i/64) % 8 == 7) {
+            lfs_file_sync(&lfs, &file) => 0;
+        }
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    lfs_file_open(&lfs, &file, "ring", LFS_O_RDWR) => 0;
+    lfs_file_size(&lfs, &file) => 4*LFS_BLOCK_SIZE;
+    lfs_foff_t base = 60*LFS_BLOCK_SIZE;
+    for (int i = 0; i < 4*LFS_BLOCK_SIZE; i++) {
+        uint8_t c;
+        lfs_file_read(&lfs, &file, &c, 1) => 1;
+        c => 'a' + (base+i) % 26;
+    }
+
+    // but the data that is left is still limited
+    lfs_file_seek(&lfs, &file, 8*LFS_BLOCK_SIZE,
+            LFS_SEEK_SET) => 8*LFS_BLOCK_SIZE;
+    lfs_file_seek(&lfs, &file, 8*LFS_BLOCK_SIZE+1,
+            LFS_SEEK_SET) => LFS_ERR_INVAL;
+    lfs_file_write(&lfs, &file, "x", 1) => LFS_ERR_FBIG;
+    lfs_file_seek(&lfs, &file, 8*LFS_BLOCK_SIZE-1,
+            LFS_SEEK_SET) => 8*LFS_BLOCK_SIZE-1;
+    lfs_file_write(&lfs, &file, "x", 1) => 1;
+    lfs_file_size(&lfs, &file) => 8*LFS_BLOCK_SIZE;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
 scripts/results.py
@@ -48,4 +48,185 @@ scripts/test.py << TEST
     lfs_unmount(&lfs) => 0;
 TEST
 
+echo "--- Checkpoint mounting ---"
+scripts/test.py << TEST
+    struct lfs_config ckptcfg = cfg;
+    ckptcfg.mount_flags = LFS_M_CHECKPOINT;
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &ckptcfg) => 0;
+    for (int i = 0; i < 20; i++) {
+        sprintf(path, "dir%03d", i);
+        lfs_mkdir(&lfs, path) => 0;
+    }
+    lfs_unmount(&lfs) => 0;
+
+    uint64_t reads = bd.stats.read_count;
+    lfs_mount(&lfs, &cfg) => 0;
+    uint64_t ckptreads = bd.stats.read_count - reads;
+    for (int i = 0; i < 20; i++) {
+        sprintf(path, "dir%03d", i);
+        lfs_stat(&lfs, path, &info) => 0;
+        info.type => LFS_TYPE_DIR;
+    }
+    lfs_rename(&lfs, "dir000", "dir020") => 0;
+    lfs_unmount(&lfs) => 0;
+
+    reads = bd.stats.read_count;
+    lfs_mount(&lfs, &cfg) => 0;
+    uint64_t scanreads = bd.stats.read_count - reads;
+    ckptreads < scanreads => 1;
+    lfs_stat(&lfs, "dir000", &info) => LFS_ERR_NOENT;
+    lfs_stat(&lfs, "dir020", &info) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    struct lfs_config ckptcfg = cfg;
+    ckptcfg.mount_flags = LFS_M_CHECKPOINT;
+    lfs_mount(&lfs, &ckptcfg) => 0;
+    lfs_fs_checkpoint(&lfs) => 0;
+    lfs_file_open(&lfs, &file, "dir001/hello",
+            LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, "hello", 5) => 5;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_setattr(&lfs, "dir002", 'A', "a", 1) => 0;
+    lfs_fs_checkpoint(&lfs) => 0;
+    lfs_remove(&lfs, "dir003") => 0;
+    // no unmount, checkpoint must not be trusted
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_stat(&lfs, "dir001/hello", &info) => 0;
+    info.size => 5;
+    lfs_getattr(&lfs, "dir002", 'A', buffer, 1) => 1;
+    lfs_stat(&lfs, "dir003", &info) => LFS_ERR_NOENT;
+    lfs_mkdir(&lfs, "dir003") => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Lazy mounting ---"
+scripts/test.py << TEST
+    struct lfs_config lazycfg = cfg;
+    lazycfg.mount_flags = LFS_M_RDONLY;
+    uint64_t reads = bd.stats.read_count;
+    lfs_mount(&lfs, &cfg) => 0;
+    uint64_t scanreads = bd.stats.read_count - reads;
+    lfs_unmount(&lfs) => 0;
+
+    uint64_t progs = bd.stats.prog_count;
+    reads = bd.stats.read_count;
+    lfs_mount(&lfs, &lazycfg) => 0;
+    uint64_t lazyreads = bd.stats.read_count - reads;
+    lazyreads < scanreads => 1;
+    lfs_stat(&lfs, "dir001/hello", &info) => 0;
+    info.size => 5;
+    lfs_file_open(&lfs, &file, "dir001/hello", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &file, buffer, 5) => 5;
+    memcmp(buffer, "hello", 5) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "dir001/hello", LFS_O_WRONLY) => LFS_ERR_ROFS;
+    lfs_mkdir(&lfs, "dir020") => LFS_ERR_ROFS;
+    lfs_remove(&lfs, "dir001/hello") => LFS_ERR_ROFS;
+    lfs_setattr(&lfs, "dir002", 'A', "b", 1) => LFS_ERR_ROFS;
+    lfs_unmount(&lfs) => 0;
+    bd.stats.prog_count => progs;
+
+    lazycfg.mount_flags = LFS_M_LAZY;
+    reads = bd.stats.read_count;
+    lfs_mount(&lfs, &lazycfg) => 0;
+    lazyreads = bd.stats.read_count - reads;
+    lazyreads < scanreads => 1;
+    lfs_getattr(&lfs, "dir002", 'A', buffer, 1) => 1;
+    lfs_rename(&lfs, "dir001/hello", "dir002/hello") => 0;
+    lfs_setattr(&lfs, "dir002", 'A', "b", 1) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_stat(&lfs, "dir001/hello", &info) => LFS_ERR_NOENT;
+    lfs_stat(&lfs, "dir002/hello", &info) => 0;
+    info.size => 5;
+    lfs_getattr(&lfs, "dir002", 'A', buffer, 1) => 1;
+    memcmp(buffer, "b", 1) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Patch limit ---"
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "patched", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    memset(buffer, 'a', 64);
+    for (int i = 0; i < 4*LFS_BLOCK_SIZE; i += 64) {
+        lfs_file_write(&lfs, &file, buffer, 64) => 64;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    // write into two blocks, each becomes a patch if we can
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDWR) => 0;
+    for (int i = 0; i < 2; i++) {
+        lfs_file_seek(&lfs, &file, i*LFS_BLOCK_SIZE + 16,
+                LFS_SEEK_SET) => i*LFS_BLOCK_SIZE + 16;
+        lfs_file_write(&lfs, &file, "b", 1) => 1;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDONLY) => 0;
+    file.ctz.pcount => lfs_min(2, LFS_PATCH_MAX);
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    // drivers that allow fewer patches can only mount read-only
+    struct lfs_config pcfg = cfg;
+    pcfg.patch_max = lfs_min(1, LFS_PATCH_MAX);
+#if LFS_PATCH_MAX >= 2
+    lfs_mount(&lfs, &pcfg) => LFS_ERR_INVAL;
+    pcfg.mount_flags = LFS_M_RDONLY;
+#endif
+    lfs_mount(&lfs, &pcfg) => 0;
+    unsigned blocks = 0;
+    lfs_fs_traverse(&lfs, test_count, &blocks) => 0;
+    lfs_unmount(&lfs) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    unsigned fullblocks = 0;
+    lfs_fs_traverse(&lfs, test_count, &fullblocks) => 0;
+    blocks => fullblocks;
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDONLY) => 0;
+    for (int i = 0; i < 2; i++) {
+        lfs_file_seek(&lfs, &file, i*LFS_BLOCK_SIZE + 15,
+                LFS_SEEK_SET) => i*LFS_BLOCK_SIZE + 15;
+        lfs_file_read(&lfs, &file, buffer, 3) => 3;
+        memcmp(buffer, "aba", 3) => 0;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+
+    // a filesystem with a smaller limit keeps it
+    pcfg.mount_flags = 0;
+    lfs_format(&lfs, &pcfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "patched", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    memset(buffer, 'a', 64);
+    for (int i = 0; i < 4*LFS_BLOCK_SIZE; i += 64) {
+        lfs_file_write(&lfs, &file, buffer, 64) => 64;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDWR) => 0;
+    for (int i = 0; i < 2; i++) {
+        lfs_file_seek(&lfs, &file, i*LFS_BLOCK_SIZE + 16,
+                LFS_SEEK_SET) => i*LFS_BLOCK_SIZE + 16;
+        lfs_file_write(&lfs, &file, "b", 1) => 1;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDONLY) => 0;
+    file.ctz.pcount => lfs_min(1, LFS_PATCH_MAX);
+    for (int i = 0; i < 2; i++) {
+        lfs_file_seek(&lfs, &file, i*LFS_BLOCK_SIZE + 15,
+                LFS_SEEK_SET) => i*LFS_BLOCK_SIZE + 15;
+        lfs_file_read(&lfs, &file, buffer, 3) => 3;
+        memcmp(buffer, "aba", 3) => 0;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
 scripts/results.py
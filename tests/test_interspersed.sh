@@ -187,4 +187,163 @@ scripts/test.py << TEST
     lfs_unmount(&lfs) => 0;
 TEST
 
+echo "--- Group sync test ---"
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_mkdir(&lfs, "sync") => 0;
+    lfs_file_t files[8];
+    for (int i = 0; i < 8; i++) {
+        sprintf(path, "%s/%c", (i < 6) ? "sync" : "", 'a'+i);
+        lfs_file_open(&lfs, &files[i], path,
+                LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    }
+
+    for (int j = 0; j < 200; j++) {
+        for (int i = 0; i < 8; i++) {
+            // leave some files inline
+            if (i % 2 == 0 || j < 4) {
+                lfs_file_write(&lfs, &files[i], &"abcdefgh"[i], 1) => 1;
+            }
+        }
+    }
+
+    uint64_t progs = bd.stats.prog_count;
+    for (int i = 0; i < 8; i++) {
+        lfs_file_sync(&lfs, &files[i]) => 0;
+    }
+    uint64_t singleprogs = bd.stats.prog_count - progs;
+
+    for (int i = 0; i < 8; i++) {
+        lfs_file_write(&lfs, &files[i], &"ABCDEFGH"[i], 1) => 1;
+    }
+
+    progs = bd.stats.prog_count;
+    lfs_fs_sync(&lfs) => 0;
+    uint64_t groupprogs = bd.stats.prog_count - progs;
+    groupprogs < singleprogs => 1;
+    lfs_fs_sync(&lfs) => 0;
+    bd.stats.prog_count => progs + groupprogs;
+    // no unmount, everything must already be on disk
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    for (int i = 0; i < 8; i++) {
+        sprintf(path, "%s/%c", (i < 6) ? "sync" : "", 'a'+i);
+        lfs_file_open(&lfs, &file, path, LFS_O_RDONLY) => 0;
+        lfs_ssize_t size = (i % 2 == 0) ? 201 : 5;
+        lfs_file_size(&lfs, &file) => size;
+        lfs_file_read(&lfs, &file, buffer, size) => size;
+        buffer[0] => 'a'+i;
+        buffer[size-2] => 'a'+i;
+        buffer[size-1] => 'A'+i;
+        lfs_file_close(&lfs, &file) => 0;
+    }
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Pooled buffers test ---"
+scripts/test.py << TEST
+    struct lfs_config poolcfg = cfg;
+    poolcfg.pool_count = 2;
+    lfs_mount(&lfs, &poolcfg) => 0;
+    lfs_mkdir(&lfs, "pool") => 0;
+    for (int i = 0; i < 4; i++) {
+        sprintf(path, "pool/small%d", i);
+        lfs_file_open(&lfs, &file, path, LFS_O_WRONLY | LFS_O_CREAT) => 0;
+        lfs_file_write(&lfs, &file, "abcdefgh", 8) => 8;
+        lfs_file_close(&lfs, &file) => 0;
+    }
+
+    // more files than buffers, each write takes a buffer from another file
+    lfs_file_t files[16];
+    for (int i = 0; i < 16; i++) {
+        sprintf(path, "pool/%c", 'a'+i);
+        lfs_file_open(&lfs, &files[i], path,
+                LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    }
+
+    for (int j = 0; j < 20; j++) {
+        for (int i = 0; i < 16; i++) {
+            for (int k = 0; k < 100; k++) {
+                buffer[k] = (uint8_t)((j*100 + k + i) % 251);
+            }
+            lfs_file_write(&lfs, &files[i], buffer, 100) => 100;
+        }
+    }
+
+    for (int i = 0; i < 16; i++) {
+        lfs_file_close(&lfs, &files[i]) => 0;
+    }
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    struct lfs_config poolcfg = cfg;
+    poolcfg.pool_count = 2;
+    lfs_mount(&lfs, &poolcfg) => 0;
+    lfs_file_t files[20];
+    for (int i = 0; i < 20; i++) {
+        if (i < 16) {
+            sprintf(path, "pool/%c", 'a'+i);
+        } else {
+            sprintf(path, "pool/small%d", i-16);
+        }
+        lfs_file_open(&lfs, &files[i], path, LFS_O_RDONLY) => 0;
+    }
+
+    // inline files are reloaded when they get a buffer back
+    for (int j = 0; j < 20; j++) {
+        for (int i = 0; i < 16; i++) {
+            lfs_file_read(&lfs, &files[i], buffer, 100) => 100;
+            for (int k = 0; k < 100; k++) {
+                buffer[k] => (uint8_t)((j*100 + k + i) % 251);
+            }
+
+            if (j < 8 && i % 4 == 0) {
+                lfs_file_t *small = &files[16 + i/4];
+                lfs_file_read(&lfs, small, buffer, 1) => 1;
+                buffer[0] => "abcdefgh"[j];
+            }
+        }
+    }
+
+    for (int i = 0; i < 20; i++) {
+        lfs_file_close(&lfs, &files[i]) => 0;
+    }
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    struct lfs_config poolcfg = cfg;
+    poolcfg.pool_count = 2;
+    lfs_mount(&lfs, &poolcfg) => 0;
+
+    // readers give up their buffers before a writer is flushed
+    lfs_file_t files[3];
+    lfs_file_open(&lfs, &files[0], "pool/a", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_open(&lfs, &files[1], "pool/b", LFS_O_RDONLY) => 0;
+    lfs_file_open(&lfs, &files[2], "pool/c", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &files[1], buffer, 1) => 1;
+    lfs_file_write(&lfs, &files[0], "x", 1) => 1;
+    for (int i = 0; i < 10; i++) {
+        lfs_file_read(&lfs, &files[1 + i%2], buffer, 1) => 1;
+        (files[0].flags & LFS_F_WRITING) => LFS_F_WRITING;
+    }
+
+    // with only writers left, the least recently used one is flushed
+    lfs_file_close(&lfs, &files[2]) => 0;
+    lfs_file_close(&lfs, &files[1]) => 0;
+    lfs_file_open(&lfs, &files[1], "pool/b", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_open(&lfs, &files[2], "pool/c", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_write(&lfs, &files[1], "x", 1) => 1;
+    lfs_file_write(&lfs, &files[2], "x", 1) => 1;
+    (files[0].flags & LFS_F_WRITING) => 0;
+    (files[1].flags & LFS_F_WRITING) => LFS_F_WRITING;
+
+    for (int i = 0; i < 3; i++) {
+        lfs_file_close(&lfs, &files[i]) => 0;
+    }
+    lfs_stat(&lfs, "pool/a", &info) => 0;
+    info.size => 2001;
+    lfs_unmount(&lfs) => 0;
+TEST
+
 scripts/results.py
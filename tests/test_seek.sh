@@ -39,7 +39,7 @@ scripts/test.py << TEST
     lfs_dir_read(&lfs, &dir, &info) => 1;
     strcmp(info.name, "..") => 0;
 
-    lfs_soff_t pos;
+    lfs_sfoff_t pos;
     int i;
     for (i = 0; i < $SMALLSIZE; i++) {
         sprintf(path, "kitty%03d", i);
@@ -81,7 +81,7 @@ scripts/test.py << TEST
     lfs_dir_read(&lfs, &dir, &info) => 1;
     strcmp(info.name, "..") => 0;
 
-    lfs_soff_t pos;
+    lfs_sfoff_t pos;
     int i;
     for (i = 0; i < $MEDIUMSIZE; i++) {
         sprintf(path, "kitty%03d", i);
@@ -119,7 +119,7 @@ scripts/test.py << TEST
     lfs_mount(&lfs, &cfg) => 0;
     lfs_file_open(&lfs, &file, "hello/kitty042", LFS_O_RDONLY) => 0;
 
-    lfs_soff_t pos;
+    lfs_sfoff_t pos;
     lfs_size_t size = strlen("kittycatcat");
     for (int i = 0; i < $SMALLSIZE; i++) {
         lfs_file_read(&lfs, &file, buffer, size) => size;
@@ -148,11 +148,11 @@ scripts/test.py << TEST
     lfs_file_read(&lfs, &file, buffer, size) => size;
     memcmp(buffer, "kittycatcat", size) => 0;
 
-    lfs_file_seek(&lfs, &file, -size, LFS_SEEK_CUR) => pos;
+    lfs_file_seek(&lfs, &file, -(lfs_sfoff_t)size, LFS_SEEK_CUR) => pos;
     lfs_file_read(&lfs, &file, buffer, size) => size;
     memcmp(buffer, "kittycatcat", size) => 0;
 
-    lfs_file_seek(&lfs, &file, -size, LFS_SEEK_END) >= 0 => 1;
+    lfs_file_seek(&lfs, &file, -(lfs_sfoff_t)size, LFS_SEEK_END) >= 0 => 1;
     lfs_file_read(&lfs, &file, buffer, size) => size;
     memcmp(buffer, "kittycatcat", size) => 0;
 
@@ -168,7 +168,7 @@ scripts/test.py << TEST
     lfs_mount(&lfs, &cfg) => 0;
     lfs_file_open(&lfs, &file, "hello/kitty042", LFS_O_RDONLY) => 0;
 
-    lfs_soff_t pos;
+    lfs_sfoff_t pos;
     lfs_size_t size = strlen("kittycatcat");
     for (int i = 0; i < $MEDIUMSIZE; i++) {
         lfs_file_read(&lfs, &file, buffer, size) => size;
@@ -197,11 +197,11 @@ scripts/test.py << TEST
     lfs_file_read(&lfs, &file, buffer, size) => size;
     memcmp(buffer, "kittycatcat", size) => 0;
 
-    lfs_file_seek(&lfs, &file, -size, LFS_SEEK_CUR) => pos;
+    lfs_file_seek(&lfs, &file, -(lfs_sfoff_t)size, LFS_SEEK_CUR) => pos;
     lfs_file_read(&lfs, &file, buffer, size) => size;
     memcmp(buffer, "kittycatcat", size) => 0;
 
-    lfs_file_seek(&lfs, &file, -size, LFS_SEEK_END) >= 0 => 1;
+    lfs_file_seek(&lfs, &file, -(lfs_sfoff_t)size, LFS_SEEK_END) >= 0 => 1;
     lfs_file_read(&lfs, &file, buffer, size) => size;
     memcmp(buffer, "kittycatcat", size) => 0;
 
@@ -217,7 +217,7 @@ scripts/test.py << TEST
     lfs_mount(&lfs, &cfg) => 0;
     lfs_file_open(&lfs, &file, "hello/kitty042", LFS_O_RDWR) => 0;
 
-    lfs_soff_t pos;
+    lfs_sfoff_t pos;
     lfs_size_t size = strlen("kittycatcat");
     for (int i = 0; i < $SMALLSIZE; i++) {
         lfs_file_read(&lfs, &file, buffer, size) => size;
@@ -242,7 +242,7 @@ scripts/test.py << TEST
     lfs_file_read(&lfs, &file, buffer, size) => size;
     memcmp(buffer, "doggodogdog", size) => 0;
 
-    lfs_file_seek(&lfs, &file, -size, LFS_SEEK_END) >= 0 => 1;
+    lfs_file_seek(&lfs, &file, -(lfs_sfoff_t)size, LFS_SEEK_END) >= 0 => 1;
     lfs_file_read(&lfs, &file, buffer, size) => size;
     memcmp(buffer, "kittycatcat", size) => 0;
 
@@ -258,7 +258,7 @@ scripts/test.py << TEST
     lfs_mount(&lfs, &cfg) => 0;
     lfs_file_open(&lfs, &file, "hello/kitty042", LFS_O_RDWR) => 0;
 
-    lfs_soff_t pos;
+    lfs_sfoff_t pos;
     lfs_size_t size = strlen("kittycatcat");
     for (int i = 0; i < $MEDIUMSIZE; i++) {
         lfs_file_read(&lfs, &file, buffer, size) => size;
@@ -285,7 +285,7 @@ scripts/test.py << TEST
     lfs_file_read(&lfs, &file, buffer, size) => size;
     memcmp(buffer, "doggodogdog", size) => 0;
 
-    lfs_file_seek(&lfs, &file, -size, LFS_SEEK_END) >= 0 => 1;
+    lfs_file_seek(&lfs, &file, -(lfs_sfoff_t)size, LFS_SEEK_END) >= 0 => 1;
     lfs_file_read(&lfs, &file, buffer, size) => size;
     memcmp(buffer, "kittycatcat", size) => 0;
 
@@ -302,10 +302,10 @@ scripts/test.py << TEST
     lfs_file_open(&lfs, &file, "hello/kitty042", LFS_O_RDWR) => 0;
 
     lfs_size_t size = strlen("hedgehoghog");
-    const lfs_soff_t offsets[] = {512, 1020, 513, 1021, 511, 1019};
+    const lfs_sfoff_t offsets[] = {512, 1020, 513, 1021, 511, 1019};
 
     for (unsigned i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
-        lfs_soff_t off = offsets[i];
+        lfs_sfoff_t off = offsets[i];
         memcpy(buffer, "hedgehoghog", size);
         lfs_file_seek(&lfs, &file, off, LFS_SEEK_SET) => off;
         lfs_file_write(&lfs, &file, buffer, size) => size;
@@ -348,11 +348,11 @@ scripts/test.py << TEST
     lfs_file_read(&lfs, &file, buffer, size) => size;
     memcmp(buffer, "\0\0\0\0\0\0\0\0\0\0\0", size) => 0;
 
-    lfs_file_seek(&lfs, &file, -(($LARGESIZE+$SMALLSIZE)*size),
+    lfs_file_seek(&lfs, &file, -(lfs_sfoff_t)(($LARGESIZE+$SMALLSIZE)*size),
             LFS_SEEK_CUR) => LFS_ERR_INVAL;
     lfs_file_tell(&lfs, &file) => ($LARGESIZE+1)*size;
 
-    lfs_file_seek(&lfs, &file, -(($LARGESIZE+2*$SMALLSIZE)*size),
+    lfs_file_seek(&lfs, &file, -(lfs_sfoff_t)(($LARGESIZE+2*$SMALLSIZE)*size),
             LFS_SEEK_END) => LFS_ERR_INVAL;
     lfs_file_tell(&lfs, &file) => ($LARGESIZE+1)*size;
 
@@ -360,6 +360,47 @@ scripts/test.py << TEST
     lfs_unmount(&lfs) => 0;
 TEST
 
+echo "--- Zero-fill seek across blocks ---"
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "zeros", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    memset(buffer, 'a', 64);
+    for (lfs_off_t i = 0; i < LFS_BLOCK_SIZE+3; i += 64) {
+        lfs_size_t chunk = lfs_min(64, LFS_BLOCK_SIZE+3 - i);
+        lfs_file_write(&lfs, &file, buffer, chunk) => chunk;
+    }
+    lfs_file_seek(&lfs, &file, 6*LFS_BLOCK_SIZE+7,
+            LFS_SEEK_SET) => 6*LFS_BLOCK_SIZE+7;
+    lfs_file_write(&lfs, &file, "porcupine", 9) => 9;
+    lfs_file_size(&lfs, &file) => 6*LFS_BLOCK_SIZE+16;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "zeros", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 6*LFS_BLOCK_SIZE+16;
+    lfs_file_seek(&lfs, &file, LFS_BLOCK_SIZE-1,
+            LFS_SEEK_SET) => LFS_BLOCK_SIZE-1;
+    lfs_file_read(&lfs, &file, buffer, 4) => 4;
+    memcmp(buffer, "aaaa", 4) => 0;
+
+    // the gap spans several blocks and reads back as zeros
+    uint8_t zeros[64] = {0};
+    for (lfs_off_t i = LFS_BLOCK_SIZE+3; i < 6*LFS_BLOCK_SIZE+7; i += 64) {
+        lfs_size_t chunk = lfs_min(64, 6*LFS_BLOCK_SIZE+7 - i);
+        lfs_file_read(&lfs, &file, buffer, chunk) => chunk;
+        memcmp(buffer, zeros, chunk) => 0;
+    }
+
+    lfs_file_read(&lfs, &file, buffer, 9) => 9;
+    memcmp(buffer, "porcupine", 9) => 0;
+    lfs_file_read(&lfs, &file, buffer, 9) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_remove(&lfs, "zeros") => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
 echo "--- Inline write and seek ---"
 for SIZE in $SMALLSIZE $MEDIUMSIZE $LARGESIZE
 do
@@ -454,7 +495,7 @@ echo "--- Root seek test ---"
     lfs_dir_close(&lfs, &dir) => 0;
 
     for (int j = 0; j < $MEDIUMSIZE; j++) {
-        lfs_soff_t off = -1;
+        lfs_sfoff_t off = -1;
 
         lfs_dir_open(&lfs, &dir, "/") => 0;
         for (int i = 0; i < $MEDIUMSIZE; i++) {
@@ -502,4 +543,323 @@ echo "--- Root seek test ---"
     lfs_unmount(&lfs) => 0;
 TEST
 
+echo "--- Seek with block index ---"
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "indexed",
+            LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) => 0;
+    for (int i = 0; i < 64*1024; i += 256) {
+        for (int j = 0; j < 256; j++) {
+            buffer[j] = (uint8_t)((i+j) % 251);
+        }
+        lfs_file_write(&lfs, &file, buffer, 256) => 256;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    uint64_t reads = bd.stats.read_count;
+    lfs_file_open(&lfs, &file, "indexed", LFS_O_RDONLY) => 0;
+    for (int i = 0; i < 256; i++) {
+        lfs_sfoff_t pos = (i*7919) % (64*1024 - 16);
+        lfs_file_seek(&lfs, &file, pos, LFS_SEEK_SET) => pos;
+        lfs_file_read(&lfs, &file, buffer, 16) => 16;
+        buffer[0] => (uint8_t)(pos % 251);
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    uint64_t walkreads = bd.stats.read_count - reads;
+
+    // small enough that the index has to skip blocks
+    uint32_t index[16];
+    struct lfs_file_config indexcfg = {
+        .index_buffer = index,
+        .index_size = sizeof(index),
+    };
+    reads = bd.stats.read_count;
+    lfs_file_opencfg(&lfs, &file, "indexed", LFS_O_RDWR, &indexcfg) => 0;
+    for (int i = 0; i < 256; i++) {
+        lfs_sfoff_t pos = (i*7919) % (64*1024 - 16);
+        lfs_file_seek(&lfs, &file, pos, LFS_SEEK_SET) => pos;
+        lfs_file_read(&lfs, &file, buffer, 16) => 16;
+        buffer[0] => (uint8_t)(pos % 251);
+    }
+    uint64_t indexreads = bd.stats.read_count - reads;
+    indexreads < walkreads => 1;
+
+    // writes must not leave stale blocks behind
+    memset(buffer, 0xcc, 1024);
+    lfs_file_seek(&lfs, &file, 32*1024, LFS_SEEK_SET) => 32*1024;
+    lfs_file_write(&lfs, &file, buffer, 1024) => 1024;
+    for (int i = 0; i < 256; i++) {
+        lfs_sfoff_t pos = (i*7919) % (64*1024 - 16);
+        lfs_file_seek(&lfs, &file, pos, LFS_SEEK_SET) => pos;
+        lfs_file_read(&lfs, &file, buffer, 1) => 1;
+        if (pos >= 32*1024 && pos < 33*1024) {
+            buffer[0] => 0xcc;
+        } else {
+            buffer[0] => (uint8_t)(pos % 251);
+        }
+    }
+    lfs_file_truncate(&lfs, &file, 16*1024) => 0;
+    lfs_file_seek(&lfs, &file, 0, LFS_SEEK_END) => 16*1024;
+    memset(buffer, 0xdd, 1024);
+    for (int i = 0; i < 32; i++) {
+        lfs_file_write(&lfs, &file, buffer, 1024) => 1024;
+    }
+    for (int i = 0; i < 256; i++) {
+        lfs_sfoff_t pos = (i*7919) % (48*1024);
+        lfs_file_seek(&lfs, &file, pos, LFS_SEEK_SET) => pos;
+        lfs_file_read(&lfs, &file, buffer, 1) => 1;
+        if (pos >= 16*1024) {
+            buffer[0] => 0xdd;
+        } else {
+            buffer[0] => (uint8_t)(pos % 251);
+        }
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Seek within a block ---"
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "indexed", LFS_O_RDONLY) => 0;
+    lfs_file_seek(&lfs, &file, 4000, LFS_SEEK_SET) => 4000;
+    lfs_file_read(&lfs, &file, buffer, 1) => 1;
+    buffer[0] => (uint8_t)(4000 % 251);
+
+    // small seeks inside the cached data shouldn't touch the device
+    lfs_size_t cached = file.cache.off + file.cache.size - (file.off-1);
+    cached = (cached < 16) ? cached : 16;
+    uint64_t reads = bd.stats.read_count;
+    for (int i = 0; i < 16; i++) {
+        lfs_sfoff_t pos = 4000 + ((i*7) % cached);
+        lfs_file_seek(&lfs, &file, pos, LFS_SEEK_SET) => pos;
+        lfs_file_read(&lfs, &file, buffer, 1) => 1;
+        buffer[0] => (uint8_t)(pos % 251);
+    }
+    bd.stats.read_count => reads;
+
+    // seeking backwards walks from the current block
+    for (int i = 0; i < 32; i++) {
+        lfs_sfoff_t pos = 15000 - i*467;
+        lfs_file_seek(&lfs, &file, pos, LFS_SEEK_SET) => pos;
+        lfs_file_read(&lfs, &file, buffer, 1) => 1;
+        buffer[0] => (uint8_t)(pos % 251);
+        lfs_file_seek(&lfs, &file, -1, LFS_SEEK_CUR) => pos;
+        lfs_file_read(&lfs, &file, buffer, 1) => 1;
+        buffer[0] => (uint8_t)(pos % 251);
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    // inline files too
+    lfs_file_open(&lfs, &file, "tiny", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, "kittycatcat", 11) => 11;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "tiny", LFS_O_RDONLY) => 0;
+    lfs_file_read(&lfs, &file, buffer, 11) => 11;
+    memcmp(buffer, "kittycatcat", 11) => 0;
+    lfs_file_seek(&lfs, &file, 5, LFS_SEEK_SET) => 5;
+    lfs_file_read(&lfs, &file, buffer, 6) => 6;
+    memcmp(buffer, "catcat", 6) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Ordered writes with seeks ---"
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "indexed", LFS_O_RDWR) => 0;
+    lfs_file_size(&lfs, &file) => 48*1024;
+
+    // forward seeks while writing only copy up to the next write, the
+    // file gets rewritten once instead of once per write
+    uint64_t progs = bd.stats.prog_count;
+    memset(buffer, 0xee, 16);
+    for (int i = 0; i < 8; i++) {
+        lfs_file_seek(&lfs, &file, i*4096+100, LFS_SEEK_SET) => i*4096+100;
+        lfs_file_write(&lfs, &file, buffer, 16) => 16;
+    }
+    lfs_file_size(&lfs, &file) => 48*1024;
+    lfs_file_close(&lfs, &file) => 0;
+    bd.stats.prog_count - progs < 2*48*1024 => 1;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "indexed", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 48*1024;
+    for (int i = 0; i < 48; i++) {
+        lfs_file_read(&lfs, &file, buffer, 1024) => 1024;
+        for (int j = 0; j < 1024; j++) {
+            lfs_foff_t pos = i*1024 + j;
+            if (pos < 8*4096 && pos % 4096 >= 100 && pos % 4096 < 116) {
+                buffer[j] => 0xee;
+            } else if (pos >= 16*1024) {
+                buffer[j] => 0xdd;
+            } else {
+                buffer[j] => (uint8_t)(pos % 251);
+            }
+        }
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Writes inside a file ---"
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "patched",
+            LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) => 0;
+    for (int i = 0; i < 64*LFS_BLOCK_SIZE; i += 64) {
+        for (int j = 0; j < 64; j++) {
+            buffer[j] = (uint8_t)((i+j) % 251);
+        }
+        lfs_file_write(&lfs, &file, buffer, 64) => 64;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    // small writes inside the file only copy the block they land in,
+    // not everything after them, unless we have no patches
+    memset(buffer, 0xee, 16);
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDWR) => 0;
+    uint64_t progs = bd.stats.prog_count;
+    lfs_file_write(&lfs, &file, buffer, 16) => 16;
+    lfs_file_sync(&lfs, &file) => 0;
+#if LFS_PATCH_MAX > 0
+    bd.stats.prog_count - progs < 4*LFS_BLOCK_SIZE => 1;
+#endif
+
+    progs = bd.stats.prog_count;
+    lfs_file_seek(&lfs, &file, 32*LFS_BLOCK_SIZE+7, LFS_SEEK_SET)
+            => 32*LFS_BLOCK_SIZE+7;
+    lfs_file_write(&lfs, &file, buffer, 16) => 16;
+    lfs_file_seek(&lfs, &file, 8, LFS_SEEK_SET) => 8;
+    lfs_file_write(&lfs, &file, buffer, 16) => 16;
+    lfs_file_close(&lfs, &file) => 0;
+#if LFS_PATCH_MAX > 0
+    bd.stats.prog_count - progs < 4*LFS_BLOCK_SIZE => 1;
+#else
+    (void)progs;
+#endif
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 64*LFS_BLOCK_SIZE;
+    for (int i = 0; i < 64*LFS_BLOCK_SIZE; i += 64) {
+        lfs_file_read(&lfs, &file, buffer, 64) => 64;
+        for (int j = 0; j < 64; j++) {
+            lfs_foff_t pos = i + j;
+            if (pos < 24 || (pos >= 32*LFS_BLOCK_SIZE+7 &&
+                    pos < 32*LFS_BLOCK_SIZE+7+16)) {
+                buffer[j] => 0xee;
+            } else {
+                buffer[j] => (uint8_t)(pos % 251);
+            }
+        }
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Many writes inside a file ---"
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDWR | LFS_O_TRUNC) => 0;
+    for (int i = 0; i < 32*LFS_BLOCK_SIZE; i += 64) {
+        memset(buffer, 'a', 64);
+        lfs_file_write(&lfs, &file, buffer, 64) => 64;
+    }
+
+    // more writes than there are patches, some syncs along the way
+    for (int k = 0; k < 40; k++) {
+        lfs_foff_t pos = (k*7919) % (32*LFS_BLOCK_SIZE - 100);
+        memset(buffer, 'A' + k % 26, 100);
+        lfs_file_seek(&lfs, &file, pos, LFS_SEEK_SET) => pos;
+        lfs_file_write(&lfs, &file, buffer, 100) => 100;
+        if (k % 7 == 0) {
+            lfs_file_sync(&lfs, &file) => 0;
+        }
+    }
+    lfs_file_size(&lfs, &file) => 32*LFS_BLOCK_SIZE;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 32*LFS_BLOCK_SIZE;
+    for (lfs_foff_t pos = 0; pos < 32*LFS_BLOCK_SIZE; pos++) {
+        uint8_t c = 'a';
+        for (int k = 0; k < 40; k++) {
+            lfs_foff_t kpos = (k*7919) % (32*LFS_BLOCK_SIZE - 100);
+            if (pos >= kpos && pos < kpos + 100) {
+                c = 'A' + k % 26;
+            }
+        }
+        lfs_file_read(&lfs, &file, buffer, 1) => 1;
+        buffer[0] => c;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Appending and truncating after writes inside a file ---"
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDWR | LFS_O_TRUNC) => 0;
+    memset(buffer, 'a', 64);
+    for (int i = 0; i < 4*LFS_BLOCK_SIZE; i += 64) {
+        lfs_file_write(&lfs, &file, buffer, 64) => 64;
+    }
+    lfs_file_close(&lfs, &file) => 0;
+
+    // patch the first and last blocks, then grow the file past them
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDWR) => 0;
+    lfs_file_write(&lfs, &file, "bbbb", 4) => 4;
+    lfs_file_seek(&lfs, &file, -4, LFS_SEEK_END) => 4*LFS_BLOCK_SIZE-4;
+    lfs_file_write(&lfs, &file, "cccc", 4) => 4;
+    lfs_file_sync(&lfs, &file) => 0;
+    lfs_file_write(&lfs, &file, "dddd", 4) => 4;
+    lfs_file_close(&lfs, &file) => 0;
+
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDWR) => 0;
+    lfs_file_seek(&lfs, &file, 4*LFS_BLOCK_SIZE-2, LFS_SEEK_SET)
+            => 4*LFS_BLOCK_SIZE-2;
+    lfs_file_write(&lfs, &file, "eeee", 4) => 4;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // copies read through the patches
+    lfs_copy(&lfs, "patched", "copied") => 0;
+    lfs_file_open(&lfs, &file, "copied", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 4*LFS_BLOCK_SIZE+4;
+    lfs_file_read(&lfs, &file, buffer, 8) => 8;
+    memcmp(buffer, "bbbbaaaa", 8) => 0;
+    lfs_file_seek(&lfs, &file, -12, LFS_SEEK_END) => 4*LFS_BLOCK_SIZE-8;
+    lfs_file_read(&lfs, &file, buffer, 12) => 12;
+    memcmp(buffer, "aaaacceeeedd", 12) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // then cut it back into a patched block
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDWR) => 0;
+    lfs_file_size(&lfs, &file) => 4*LFS_BLOCK_SIZE+4;
+    lfs_file_seek(&lfs, &file, -12, LFS_SEEK_END) => 4*LFS_BLOCK_SIZE-8;
+    lfs_file_read(&lfs, &file, buffer, 12) => 12;
+    memcmp(buffer, "aaaacceeeedd", 12) => 0;
+    lfs_file_truncate(&lfs, &file, 2) => 0;
+    lfs_file_seek(&lfs, &file, 0, LFS_SEEK_END) => 2;
+    lfs_file_write(&lfs, &file, "ff", 2) => 2;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "patched", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 4;
+    lfs_file_read(&lfs, &file, buffer, 4) => 4;
+    memcmp(buffer, "bbff", 4) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
 scripts/results.py
@@ -352,4 +352,137 @@ truncate_test \
     "2*$LARGESIZE, 2*$LARGESIZE, 2*$LARGESIZE, 2*$LARGESIZE, 2*$LARGESIZE" \
     "2*$LARGESIZE, 2*$LARGESIZE, 2*$LARGESIZE, 2*$LARGESIZE, 2*$LARGESIZE"
 
+echo "--- Sparse truncate ---"
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "sparse", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, "hello", 5) => 5;
+    uint64_t progs = bd.stats.prog_count;
+    lfs_file_truncate(&lfs, &file, 256*1024) => 0;
+    lfs_file_size(&lfs, &file) => 256*1024;
+    lfs_file_close(&lfs, &file) => 0;
+    bd.stats.prog_count - progs < 16*1024 => 1;
+
+    lfs_stat(&lfs, "sparse", &info) => 0;
+    info.size => 256*1024;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_stat(&lfs, "sparse", &info) => 0;
+    info.size => 256*1024;
+    lfs_file_open(&lfs, &file, "sparse", LFS_O_RDWR) => 0;
+    lfs_file_size(&lfs, &file) => 256*1024;
+    lfs_file_read(&lfs, &file, buffer, 5) => 5;
+    memcmp(buffer, "hello", 5) => 0;
+
+    uint64_t reads = bd.stats.read_count;
+    lfs_file_seek(&lfs, &file, 128*1024, LFS_SEEK_SET) => 128*1024;
+    memset(buffer, 0xcc, 1024);
+    lfs_file_read(&lfs, &file, buffer, 1024) => 1024;
+    bd.stats.read_count => reads;
+    for (int i = 0; i < 1024; i++) {
+        buffer[i] => 0;
+    }
+
+    // write into the hole, the rest of the hole stays
+    lfs_file_seek(&lfs, &file, 1000, LFS_SEEK_SET) => 1000;
+    lfs_file_write(&lfs, &file, "world", 5) => 5;
+    lfs_file_size(&lfs, &file) => 256*1024;
+    lfs_file_seek(&lfs, &file, -1, LFS_SEEK_END) => 256*1024-1;
+    lfs_file_write(&lfs, &file, "!", 1) => 1;
+    lfs_file_size(&lfs, &file) => 256*1024;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "sparse", LFS_O_RDWR) => 0;
+    lfs_file_size(&lfs, &file) => 256*1024;
+    lfs_file_read(&lfs, &file, buffer, 5) => 5;
+    memcmp(buffer, "hello", 5) => 0;
+    lfs_file_seek(&lfs, &file, 995, LFS_SEEK_SET) => 995;
+    lfs_file_read(&lfs, &file, buffer, 10) => 10;
+    memcmp(buffer, "\0\0\0\0\0world", 10) => 0;
+    lfs_file_seek(&lfs, &file, -2, LFS_SEEK_END) => 256*1024-2;
+    lfs_file_read(&lfs, &file, buffer, 2) => 2;
+    memcmp(buffer, "\0!", 2) => 0;
+
+    // shrinking into the data drops the hole
+    lfs_file_truncate(&lfs, &file, 1000) => 0;
+    lfs_file_truncate(&lfs, &file, 2000) => 0;
+    lfs_file_seek(&lfs, &file, 0, LFS_SEEK_END) => 2000;
+    lfs_file_write(&lfs, &file, "end", 3) => 3;
+    lfs_file_size(&lfs, &file) => 2003;
+    lfs_file_seek(&lfs, &file, 990, LFS_SEEK_SET) => 990;
+    lfs_file_read(&lfs, &file, buffer, 20) => 20;
+    memcmp(buffer, "\0\0\0\0\0\0\0\0\0\0"
+                   "\0\0\0\0\0\0\0\0\0\0", 20) => 0;
+    lfs_file_seek(&lfs, &file, -4, LFS_SEEK_END) => 1999;
+    lfs_file_read(&lfs, &file, buffer, 4) => 4;
+    memcmp(buffer, "\0end", 4) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+
+    // appends land after the hole
+    lfs_file_open(&lfs, &file, "sparse", LFS_O_WRONLY | LFS_O_APPEND) => 0;
+    lfs_file_truncate(&lfs, &file, 3000) => 0;
+    lfs_file_write(&lfs, &file, "!", 1) => 1;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_file_open(&lfs, &file, "sparse", LFS_O_RDONLY) => 0;
+    lfs_file_size(&lfs, &file) => 3001;
+    lfs_file_seek(&lfs, &file, 1999, LFS_SEEK_SET) => 1999;
+    lfs_file_read(&lfs, &file, buffer, 10) => 10;
+    memcmp(buffer, "\0end\0\0\0\0\0\0", 10) => 0;
+    lfs_file_seek(&lfs, &file, -2, LFS_SEEK_END) => 2999;
+    lfs_file_read(&lfs, &file, buffer, 2) => 2;
+    memcmp(buffer, "\0!", 2) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+
+echo "--- Large file truncate ---"
+scripts/test.py << TEST
+    lfs_format(&lfs, &cfg) => 0;
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_file_open(&lfs, &file, "large", LFS_O_WRONLY | LFS_O_CREAT) => 0;
+    lfs_file_write(&lfs, &file, "hello", 5) => 5;
+#ifdef LFS_OFF64
+    lfs_file_truncate(&lfs, &file, 5000000000) => 0;
+    lfs_file_size(&lfs, &file) => 5000000000;
+    lfs_file_seek(&lfs, &file, -5, LFS_SEEK_END) => 4999999995;
+    lfs_file_tell(&lfs, &file) => 4999999995;
+#else
+    lfs_file_truncate(&lfs, &file, 3000000000) => LFS_ERR_INVAL;
+#endif
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_unmount(&lfs) => 0;
+TEST
+scripts/test.py << TEST
+    lfs_mount(&lfs, &cfg) => 0;
+    lfs_stat(&lfs, "large", &info) => 0;
+#ifdef LFS_OFF64
+    info.size => 5000000000;
+    lfs_file_open(&lfs, &file, "large", LFS_O_RDWR) => 0;
+    lfs_file_size(&lfs, &file) => 5000000000;
+    lfs_file_read(&lfs, &file, buffer, 5) => 5;
+    memcmp(buffer, "hello", 5) => 0;
+    lfs_file_seek(&lfs, &file, 4500000000, LFS_SEEK_SET) => 4500000000;
+    memset(buffer, 0xcc, 16);
+    lfs_file_read(&lfs, &file, buffer, 16) => 16;
+    for (int i = 0; i < 16; i++) {
+        buffer[i] => 0;
+    }
+
+    // shrinking back under 32-bits goes back to the small ctz struct
+    lfs_file_truncate(&lfs, &file, 4096) => 0;
+    lfs_file_close(&lfs, &file) => 0;
+    lfs_stat(&lfs, "large", &info) => 0;
+    info.size => 4096;
+#else
+    info.size => 5;
+#endif
+    lfs_unmount(&lfs) => 0;
+TEST
+
 scripts/results.py